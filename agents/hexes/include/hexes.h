@@ -32,13 +32,15 @@
 #include <arpa/inet.h>
 #include <math.h>
 #include <netdb.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <time.h>
 #include <unistd.h>
 
 struct opts {
-	u32 log_level, agent_type;
+	u32 log_level, agent_type, playout_policy;
+	bool prefault;
 	char *host, *port;
 };
 
@@ -5,6 +5,7 @@
 
 #include "hexes/board.h"
 #include "hexes/threadpool.h"
+#include "hexes/timeman.h"
 
 #include "hexes/agent/random.h"
 #include "hexes/agent/mcts.h"
@@ -35,7 +36,13 @@ agent_play(struct agent *self, enum hex_player player, u32 x, u32 y);
 void
 agent_swap(struct agent *self);
 
+void
+agent_ponder_start(struct agent *self);
+
+void
+agent_ponder_stop(struct agent *self);
+
 bool
-agent_next(struct agent *self, struct timespec timeout, u32 *out_x, u32 *out_y);
+agent_next(struct agent *self, struct timeman_budget const *budget, u32 *out_x, u32 *out_y);
 
 #endif /* HEXES_AGENT_H */
@@ -3,52 +3,297 @@
 
 #include "hexes.h"
 
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "hexes/bitboard.h"
 #include "hexes/board.h"
+#include "hexes/dfpn.h"
+#include "hexes/hsearch.h"
+#include "hexes/memory.h"
+#include "hexes/playout.h"
+#include "hexes/stats.h"
 #include "hexes/threadpool.h"
+#include "hexes/timeman.h"
+#include "hexes/ttable.h"
 #include "hexes/utils.h"
+#include "hexes/zobrist.h"
+
+/* memory left outside of the node pool and transposition table, for libc,
+ * network buffers and the stacks of our helper threads (pondering and
+ * prefaulting), as thread stacks count against the data limit too
+ */
+#define RESERVED_MEM (4 * MiB)
+
+#define MCTS_THREAD_STACK (MiB)
+#define MCTS_HELPER_THREADS 2
+
+/* the node pool is optionally faulted in by a background thread, this many
+ * bytes at a time
+ */
+#define MCTS_PREFAULT_CHUNK (64 * MiB)
+
+/* fraction of the node pool to reclaim once it is exhausted mid-search */
+#define MCTS_RECLAIM_FRACTION 16
+
+/* fraction of the memory limit given to the transposition table, and the
+ * number of plays that statistics from the table are worth when seeding a
+ * newly expanded child (so that a transposition informs, but never swamps,
+ * the statistics gathered along the child's own path)
+ */
+#define MCTS_TTABLE_FRACTION 8
+#define MCTS_TTABLE_PRIOR_PLAYS 32
+
+/* fraction of the memory limit given to the endgame solver, the number of
+ * empty cells below which it is tried before every search, and the fraction
+ * of the soft budget (and number of nodes) it may spend doing so
+ */
+#define MCTS_DFPN_FRACTION 16
+#define MCTS_DFPN_MAX_EMPTY 40
+#define MCTS_DFPN_TIME_FRACTION 4
+#define MCTS_DFPN_MAX_NODES (4 * 1000 * 1000)
+
+/* after the endgame solver fails to prove a win, it is only tried again
+ * once this many more cells have been filled
+ */
+#define MCTS_DFPN_RETRY_EMPTY 4
 
-#define RESERVED_MEM (MiB)
+/* fraction of the soft budget that updating the virtual connections for
+ * the opponent's move may spend, split evenly between both players' engines
+ */
+#define MCTS_HSEARCH_TIME_FRACTION 8
 
-typedef s64 mcts_node_relptr_t;
+/* the search runs past its soft deadline (up to the hard deadline) while
+ * the runner-up root move has at least this fraction of the best move's plays
+ */
+#define MCTS_CONTESTED_RATIO 0.8f
 
+/* the statistics used by the mcts-rave formula */
+#define MCTS_EXPLORATION_ROUNDS 3000
+#define MCTS_EXPLORATION_PARAM M_SQRT2
+
+/* nodes and child blocks are addressed by 32-bit references, counting
+ * MCTS_POOL_ALIGN-byte units from the start of the node pool (offset by one,
+ * so that the null reference never aliases the first allocation)
+ */
+#define MCTS_POOL_ALIGN 8
+
+typedef u32 mcts_ref_t;
+
+#define MCTS_REF_NULL ((mcts_ref_t) 0)
+
+inline mcts_ref_t
+mcts_ref(void const *base, void const *absptr)
+{
+	if (!absptr) return MCTS_REF_NULL;
+
+	return (mcts_ref_t) (((u8 const *) absptr - (u8 const *) base) / MCTS_POOL_ALIGN) + 1;
+}
+
+inline void *
+mcts_deref(void const *base, mcts_ref_t ref)
+{
+	if (ref == MCTS_REF_NULL) return NULL;
+
+	return (u8 *) base + (size_t) (ref - 1) * MCTS_POOL_ALIGN;
+}
+
+/* the game-theoretic value of a node once it is known, for the player that
+ * moved into it. a move that wins makes the position before it lost, and a
+ * position is won once every move from it is known to lose
+ */
+enum mcts_proof {
+	MCTS_PROOF_NONE,
+	MCTS_PROOF_WIN,
+	MCTS_PROOF_LOSS,
+};
+
+/* a node only records its own position in the tree, with the statistics of
+ * its children held in a separately allocated child block. the block is
+ * allocated on first expansion and doubled whenever it fills up, so that
+ * leaves (by far the most common nodes) stay small
+ */
 struct mcts_node {
-	mcts_node_relptr_t parent;
-	enum hex_player player;
-	u8 x, y;
+	mcts_ref_t parent, block;
+	u32 plays;
 
-	s32 wins, rave_wins;
-	u32 plays, rave_plays;
+	/* the slot of this node in its parent's block, the number of legal
+	 * moves from this node, and the number of those moves expanded
+	 */
+	u16 index, moves, children_len;
 
-	u16 children_cap, children_len;
-	mcts_node_relptr_t children[];
+	u8 x, y, player, proof;
+};
+
+/* child block capacities are powers of two, padded to a whole number of
+ * score vectors, and each capacity is its own size class for recycling
+ */
+#define MCTS_BLOCK_MIN_CAP 8
+#define MCTS_BLOCK_CLASSES 8
+
+_Static_assert(MCTS_BLOCK_MIN_CAP << (MCTS_BLOCK_CLASSES - 1) >= BITBOARD_MAX_SIZE * BITBOARD_MAX_SIZE,
+	       "Largest child block must fit every move on the largest board");
+
+struct mcts_block {
+	u32 cap;
+
+	/* the references to all children, followed by the 16 bytes of
+	 * statistics, the cell and the proof of all children, as parallel
+	 * arrays of cap elements
+	 */
+	mcts_ref_t nodes[];
+};
+
+struct mcts_children {
+	mcts_ref_t *nodes;
+	s32 *wins, *rave_wins;
+	u32 *plays, *rave_plays;
+	u16 *cells;
+	u8 *proofs;
 };
 
 inline size_t
-mcts_node_sizeof(size_t children)
+mcts_block_sizeof(size_t cap)
 {
-	return sizeof(struct mcts_node) + children * sizeof(mcts_node_relptr_t);
+	size_t child_sizeof = sizeof(mcts_ref_t)
+			    + 2 * sizeof(s32) + 2 * sizeof(u32)
+			    + sizeof(u16) + sizeof(u8);
+
+	size_t size = sizeof(struct mcts_block) + cap * child_sizeof;
+
+	return (size + MCTS_POOL_ALIGN - 1) & ~(size_t) (MCTS_POOL_ALIGN - 1);
 }
 
-inline mcts_node_relptr_t
-mcts_node_abs2rel(void *base, struct mcts_node *absptr)
+inline size_t
+mcts_block_class(size_t cap)
 {
-	return RELPTR_ABS2REL(mcts_node_relptr_t, base, absptr);
+	size_t class = 0;
+	while ((size_t) MCTS_BLOCK_MIN_CAP << class < cap) class++;
+
+	return class;
 }
 
-inline struct mcts_node *
-mcts_node_rel2abs(void *base, mcts_node_relptr_t relptr)
+inline struct mcts_children
+mcts_block_children(struct mcts_block *self)
 {
-	return RELPTR_REL2ABS(struct mcts_node *, mcts_node_relptr_t, base, relptr);
+	size_t cap = self->cap;
+
+	struct mcts_children children;
+	children.nodes = self->nodes;
+	children.wins = (s32 *) (children.nodes + cap);
+	children.plays = (u32 *) (children.wins + cap);
+	children.rave_wins = (s32 *) (children.plays + cap);
+	children.rave_plays = (u32 *) (children.rave_wins + cap);
+	children.cells = (u16 *) (children.rave_plays + cap);
+	children.proofs = (u8 *) (children.cells + cap);
+
+	return children;
 }
 
 struct agent_mcts {
 	struct board const *board;
 	struct threadpool *threadpool;
+	enum hex_player player;
+
+	/* search runs on bitboards, with the root board loaded from the game
+	 * board once per search and copied into the shadow board every round
+	 */
+	struct bitboard_geometry geometry;
+	struct bitboard root_board, shadow_board;
+
+	/* the empty cells of the root board, from which every round derives
+	 * its moves without scanning the whole board. dead cells are left out
+	 * (as neither player gains from them), and captured cells are filled
+	 * in for their capturer on the root board. root_filled marks the cells
+	 * filled in or left out by the last load, which the tree was built on
+	 */
+	u16 root_cells[BITBOARD_MAX_SIZE * BITBOARD_MAX_SIZE];
+	u32 root_cells_len;
+	bool root_filled[BITBOARD_MAX_SIZE * BITBOARD_MAX_SIZE];
+
+	/* whether moves dominated for the player to move are left out at the
+	 * root, which we give up on should no other move remain
+	 */
+	bool root_dominance;
+
+	/* the playout kernel specialised for the board size, if there is one */
+	playout_batch_fn playout;
+	struct playout_batch batch;
+
+	/* the amaf plays and wins that the current batch adds to a move of each
+	 * player on each cell, computed once per round and gathered by every
+	 * node on the backpropagation path
+	 */
+	s32 rave_plays_delta[2][BITBOARD_MAX_SIZE * BITBOARD_MAX_SIZE];
+	s32 rave_wins_delta[2][BITBOARD_MAX_SIZE * BITBOARD_MAX_SIZE];
+
+	/* statistics of every position seen, keyed by the hash of the position
+	 * and the player that moved into it, which outlive both reclaimed
+	 * subtrees and the tree of the previous move. path holds the keys of
+	 * the nodes visited in the current round, by depth
+	 */
+	struct ttable ttable;
+	u64 path[BITBOARD_MAX_SIZE * BITBOARD_MAX_SIZE + 1];
 
-	struct board shadow_board;
+	/* the virtual connections of both players in the game position, which
+	 * settle won positions outright and restrict the root to the moves
+	 * that stop an opponent connection (on boards small enough for them)
+	 */
+	struct hsearch hsearch[2];
+	bool hsearch_enabled;
+
+	/* the opponent's move is only played into the engines once our own
+	 * move is asked for, so that the update is charged to its budget
+	 */
+	struct move hsearch_pending;
+	bool hsearch_pending_valid;
+
+	/* while the root is restricted, only the allowed cells are expanded
+	 * below it
+	 */
+	hsearch_set_t root_allowed;
+	bool root_pruned;
+
+	/* the endgame solver, which plays a proven win outright, and the empty
+	 * cells left when it last failed to (or SIZE_MAX)
+	 */
+	struct dfpn dfpn;
+	size_t dfpn_failed_empty;
 
 	struct mem_pool pool;
 	struct mcts_node *root;
+
+	/* recycled nodes and child blocks, with blocks keyed by their size
+	 * class, linked through their first word
+	 */
+	mcts_ref_t free_nodes, free_blocks[MCTS_BLOCK_CLASSES];
+
+	u32 reclaim_threshold;
+	size_t reclaimed_nodes, reclaimed_bytes;
+
+	/* a background search of the position after our own move, run while
+	 * the opponent thinks and stopped once their move arrives. should the
+	 * thread limit leave no room for it, pondering is given up for the game
+	 */
+	pthread_t ponder_thread;
+	atomic_bool ponder_stop;
+	bool pondering, ponder_unavailable;
+	u64 ponder_seed;
+	size_t ponder_rounds;
+	u64 ponder_start;
+
+	/* totals of the last completed search */
+	size_t search_rounds, search_nodes;
+	u64 search_nanos;
+
+	/* instrumentation of the current search (or ponder), reported once
+	 * it completes
+	 */
+	struct stats stats;
+
+	pthread_t prefault_thread;
+	atomic_bool prefault_stop;
+	bool prefaulting;
 };
 
 bool
@@ -64,8 +309,13 @@ agent_mcts_play(struct agent_mcts *self, enum hex_player player, u32 x, u32 y);
 void
 agent_mcts_swap(struct agent_mcts *self);
 
-bool
-agent_mcts_next(struct agent_mcts *self, struct timespec timeout, u32 *out_x, u32 *out_y);
+void
+agent_mcts_ponder_start(struct agent_mcts *self);
 
+void
+agent_mcts_ponder_stop(struct agent_mcts *self);
+
+bool
+agent_mcts_next(struct agent_mcts *self, struct timeman_budget const *budget, u32 *out_x, u32 *out_y);
 
 #endif /* HEXES_AGENT_MCTS_H */
@@ -4,6 +4,7 @@
 #include "hexes.h"
 
 #include "hexes/board.h"
+#include "hexes/timeman.h"
 #include "hexes/utils.h"
 
 struct agent_random {
@@ -24,6 +25,6 @@ void
 agent_random_swap(struct agent_random *self);
 
 bool
-agent_random_next(struct agent_random *self, struct timespec timeout, u32 *out_x, u32 *out_y);
+agent_random_next(struct agent_random *self, struct timeman_budget const *budget, u32 *out_x, u32 *out_y);
 
 #endif /* HEXES_AGENT_RANDOM_H */
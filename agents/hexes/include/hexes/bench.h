@@ -0,0 +1,29 @@
+#ifndef HEXES_BENCH_H
+#define HEXES_BENCH_H
+
+#include "hexes.h"
+
+#include "hexes/agent.h"
+#include "hexes/board.h"
+
+/* the default benchmark runs a fixed number of rounds per position, so
+ * that two builds do exactly the same work for the same seed
+ */
+#define BENCH_DEFAULT_ROUNDS 20000
+#define BENCH_DEFAULT_SEED 0x6865786573ULL
+#define BENCH_DEFAULT_MEM_MIB 1024
+
+/* a position is given as the moves leading to it, alternating between
+ * black and white (starting with black), in the usual hex notation of a
+ * column letter followed by a row number (e.g. "a1 c3 b2")
+ */
+struct bench_position {
+	u32 size;
+	char const *moves;
+};
+
+/* runs the benchmark, taking the arguments following the bench subcommand */
+bool
+bench_run(int argc, char **argv);
+
+#endif /* HEXES_BENCH_H */
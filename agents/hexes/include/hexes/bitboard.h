@@ -0,0 +1,111 @@
+#ifndef HEXES_BITBOARD_H
+#define HEXES_BITBOARD_H
+
+#include "hexes.h"
+
+#include "hexes/board.h"
+
+__extension__ typedef unsigned __int128 u128;
+
+/* boards of up to 11x11 cells fit into a single 128-bit integer per colour,
+ * larger boards use a wide bitset whose word loops are written to be
+ * vectorised by the compiler
+ */
+#define BITBOARD_NARROW_MAX_SIZE 11
+#define BITBOARD_MAX_SIZE BOARD_MAX_SIZE
+
+#define BITSET_WORD_BITS 64
+#define BITSET_WORDS ((BITBOARD_MAX_SIZE * BITBOARD_MAX_SIZE) / BITSET_WORD_BITS)
+
+struct bitset {
+	alignas(32) u64 words[BITSET_WORDS];
+};
+
+union bitboard_set {
+	u128 narrow;
+	struct bitset wide;
+};
+
+/* cell (x, y) is stored in bit (y * size + x), and the masks below are shared
+ * between every bitboard of the same size
+ */
+struct bitboard_geometry {
+	u32 size, cells, words;
+	bool narrow;
+
+	union bitboard_set mask, not_first_col, not_last_col;
+	union bitboard_set edges[_BOARD_EDGE_COUNT];
+
+	/* the neighbours of every cell in pattern order, with a neighbour off
+	 * the board given as the index past the last cell offset by the
+	 * pattern state read for it (so that an array of cell states, followed
+	 * by one entry per state, yields the neighbourhood code of any cell)
+	 */
+	u16 ring[BITBOARD_MAX_SIZE * BITBOARD_MAX_SIZE][PATTERN_NEIGHBOURS];
+};
+
+struct bitboard {
+	struct bitboard_geometry const *geometry;
+
+	/* stones of each player, and the subset of those stones that is
+	 * connected to the player's source edge
+	 */
+	union bitboard_set stones[2], reach[2];
+
+	/* zobrist hash of the stones on the board, updated incrementally */
+	u64 hash;
+};
+
+inline bool
+bitboard_supported(u32 size)
+{
+	return 0 < size && size <= BITBOARD_MAX_SIZE;
+}
+
+inline bool
+bitboard_set_test(struct bitboard_geometry const *geometry, union bitboard_set const *set, u32 x, u32 y)
+{
+	u32 idx = y * geometry->size + x;
+
+	if (geometry->narrow) return (set->narrow >> idx) & 1;
+
+	return (set->wide.words[idx / BITSET_WORD_BITS] >> (idx % BITSET_WORD_BITS)) & 1;
+}
+
+inline bool
+bitboard_occupied(struct bitboard const *self, u32 idx)
+{
+	if (self->geometry->narrow)
+		return ((self->stones[HEX_PLAYER_BLACK].narrow | self->stones[HEX_PLAYER_WHITE].narrow) >> idx) & 1;
+
+	u32 word = idx / BITSET_WORD_BITS;
+	u64 stones = self->stones[HEX_PLAYER_BLACK].wide.words[word] | self->stones[HEX_PLAYER_WHITE].wide.words[word];
+
+	return (stones >> (idx % BITSET_WORD_BITS)) & 1;
+}
+
+bool
+bitboard_geometry_init(struct bitboard_geometry *self, u32 size);
+
+void
+bitboard_init(struct bitboard *self, struct bitboard_geometry const *geometry);
+
+void
+bitboard_copy(struct bitboard const *restrict self, struct bitboard *restrict other);
+
+void
+bitboard_load(struct bitboard *self, struct board const *board);
+
+bool
+bitboard_play(struct bitboard *self, enum hex_player player, u32 x, u32 y);
+
+enum cell
+bitboard_cell(struct bitboard const *self, u32 x, u32 y);
+
+size_t
+bitboard_available_moves(struct bitboard const *self, struct move *buf);
+
+bool
+bitboard_winner(struct bitboard const *self, enum hex_player *out);
+
+#endif /* HEXES_BITBOARD_H */
@@ -3,6 +3,10 @@
 
 #include "hexes.h"
 
+#include "hexes/pattern.h"
+
+#define BOARD_MAX_SIZE 32
+
 enum cell {
 	CELL_BLACK = HEX_PLAYER_BLACK,
 	CELL_WHITE = HEX_PLAYER_WHITE,
@@ -37,9 +41,79 @@ enum board_edges {
 	_BOARD_EDGE_COUNT,
 };
 
+/* the previous state of a segment changed by a journaled move */
+struct board_undo {
+	u16 segment;
+	segment_relptr_t parent;
+	u32 rank;
+};
+
+/* a journaled move, and the journal length from before it was made */
+struct board_frame {
+	u32 journal_len;
+	u16 cell;
+	u8 player;
+};
+
+/* a move touches at most its edge and its six neighbours, and every merge
+ * changes at most two roots
+ */
+#define BOARD_UNDO_PER_MOVE (2 * 7)
+
+/* the inferior cells of a position, found from the neighbourhood patterns of
+ * its empty cells:
+ *  - dead cells never matter to either player
+ *  - cells captured by a player come in pairs, either of which the player
+ *    answers with the other, and so can be filled in with their stones
+ *  - a cell is vulnerable to a player when their stone on a neighbouring
+ *    cell would kill it
+ *  - a move by a player to a dominated cell is never better than their move
+ *    to the (neighbouring, non-inferior) cell that would kill it
+ */
+enum board_inferior {
+	INFERIOR_DEAD			= 1 << 0,
+	INFERIOR_CAPTURED_BLACK		= 1 << 1,
+	INFERIOR_CAPTURED_WHITE		= 1 << 2,
+	INFERIOR_VULNERABLE_BLACK	= 1 << 3,
+	INFERIOR_VULNERABLE_WHITE	= 1 << 4,
+	INFERIOR_DOMINATED_BLACK	= 1 << 5,
+	INFERIOR_DOMINATED_WHITE	= 1 << 6,
+};
+
+#define INFERIOR_CAPTURED(player) (INFERIOR_CAPTURED_BLACK << (player))
+#define INFERIOR_VULNERABLE(player) (INFERIOR_VULNERABLE_BLACK << (player))
+#define INFERIOR_DOMINATED(player) (INFERIOR_DOMINATED_BLACK << (player))
+
+#define INFERIOR_FILLIN (INFERIOR_DEAD | INFERIOR_CAPTURED_BLACK | INFERIOR_CAPTURED_WHITE)
+
 struct board {
 	u32 size;
 	struct segment *segments;
+
+	/* zobrist hash of the stones on the board, updated incrementally */
+	u64 hash;
+
+	/* the empty cells as a dense array of cell indices, and the position
+	 * of every cell within that array, so that a cell is removed in O(1)
+	 * by swapping it with the last empty cell
+	 */
+	u16 *empty, *empty_pos;
+	u32 empty_len;
+
+	/* moves made with board_make can be taken back with board_unmake, as
+	 * long as the union-find paths are not compressed. while any such move
+	 * is outstanding, every merge is journaled and no path is compressed
+	 */
+	struct board_undo *journal;
+	struct board_frame *frames;
+	u32 journal_len, frames_len;
+
+	/* the neighbourhood code of every cell, and the inferior flags of
+	 * every empty cell, updated around every move made with board_play
+	 * (journaled moves leave both untouched)
+	 */
+	pattern_code_t *codes;
+	u8 *inferior;
 };
 
 inline struct segment *
@@ -85,10 +159,22 @@ board_play(struct board *self, enum hex_player player, u32 x, u32 y);
 void
 board_swap(struct board *self);
 
+bool
+board_make(struct board *self, enum hex_player player, u32 x, u32 y);
+
+void
+board_unmake(struct board *self);
+
 size_t
 board_available_moves(struct board const *self, struct move *buf);
 
 bool
 board_winner(struct board *self, enum hex_player *out);
 
+/* whether a stone of the player on the given empty cell would connect the
+ * player's edges, without placing it
+ */
+bool
+board_completes(struct board *self, enum hex_player player, u32 x, u32 y);
+
 #endif /* HEXES_BOARD_H */
@@ -0,0 +1,92 @@
+#ifndef HEXES_DFPN_H
+#define HEXES_DFPN_H
+
+#include "hexes.h"
+
+#include "hexes/board.h"
+#include "hexes/utils.h"
+#include "hexes/zobrist.h"
+
+/* a depth-first proof-number solver, proving whether the player to move wins
+ * a position. proof and disproof numbers are kept from the point of view of
+ * the player to move at every node (so a node is proven once its proof number
+ * reaches zero, and disproven once its disproof number does), with all but
+ * the current path held in a transposition table.
+ *
+ * hex has neither draws nor cycles, so every position is either won or lost
+ * for the player to move, and the value of a position is independent of the
+ * path taken to reach it
+ */
+#define DFPN_INF UINT32_MAX
+
+/* the second-best child bounds the threshold of the best one, raised by a
+ * fraction of 1/2^DFPN_EPSILON_SHIFT so that the search does not flip
+ * between two children of almost equal cost (the 1+epsilon trick)
+ */
+#define DFPN_EPSILON_SHIFT 2
+
+/* the clock is read once every so many nodes */
+#define DFPN_POLL_NODES 4096
+
+/* a bucket of entries fills exactly one cache line, with entries verified
+ * by the upper half of the position hash (the lower half selecting the
+ * bucket), and replaced by the amount of work done below them
+ */
+#define DFPN_BUCKET_ENTRIES 4
+
+struct dfpn_entry {
+	u32 check;
+	u32 pn, dn;
+	u32 work;
+};
+
+struct dfpn_bucket {
+	alignas(64) struct dfpn_entry entries[DFPN_BUCKET_ENTRIES];
+};
+
+_Static_assert(sizeof(struct dfpn_bucket) == 64, "DFPN bucket must fill a cache line");
+
+enum dfpn_result {
+	DFPN_UNKNOWN,
+	DFPN_WIN,
+	DFPN_LOSS,
+};
+
+struct dfpn {
+	/* a private copy of the position being solved, on which moves are
+	 * made and unmade along the current path
+	 */
+	struct board board;
+
+	/* the arena holds the transposition table, followed by the moves of
+	 * every node on the current path (allocated on entry and released on
+	 * exit, as a stack)
+	 */
+	struct mem_pool pool;
+	struct dfpn_bucket *buckets;
+	size_t mask;
+
+	/* the limits of the current solve, and whether either was reached */
+	u64 deadline;
+	size_t nodes, max_nodes;
+	bool aborted;
+
+	/* the proven winning move of the root, if any */
+	u16 best;
+};
+
+bool
+dfpn_init(struct dfpn *self, u32 size, size_t capacity);
+
+void
+dfpn_free(struct dfpn *self);
+
+/* proves or disproves the position on the board for the player to move,
+ * within the given deadline (in monotonic nanoseconds) and number of nodes.
+ * entries from earlier solves are kept, as positions never go stale
+ */
+enum dfpn_result
+dfpn_solve(struct dfpn *self, struct board const *board, enum hex_player player,
+	   u64 deadline, size_t max_nodes, u32 *out_x, u32 *out_y);
+
+#endif /* HEXES_DFPN_H */
@@ -0,0 +1,143 @@
+#ifndef HEXES_HSEARCH_H
+#define HEXES_HSEARCH_H
+
+#include "hexes.h"
+
+#include "hexes/bitboard.h"
+#include "hexes/board.h"
+
+/* h-search derives virtual connections (vcs) for one player: a full vc
+ * between two nodes is a set of empty cells (the carrier) within which the
+ * player can connect the two nodes even when the opponent moves first, and
+ * a semi vc is one where the player has to move first (at its key).
+ *
+ * nodes are the cells of the board and the player's two edges, with vcs
+ * only ever ending in empty cells, own stones and own edges. every carrier
+ * is a bitset over the cells, so the engine is limited to boards whose cells
+ * fit into a single 128-bit integer
+ */
+#define HSEARCH_MAX_SIZE BITBOARD_NARROW_MAX_SIZE
+#define HSEARCH_MAX_CELLS (HSEARCH_MAX_SIZE * HSEARCH_MAX_SIZE)
+#define HSEARCH_MAX_NODES (HSEARCH_MAX_CELLS + 2)
+
+_Static_assert(HSEARCH_MAX_NODES <= 128, "Every node must fit into a node set");
+
+/* the vcs kept per pair of nodes, preferring the smallest carriers, and the
+ * depth to which the or rule combines semi vcs
+ */
+#define HSEARCH_MAX_FULL 4
+#define HSEARCH_MAX_SEMI 8
+#define HSEARCH_OR_DEPTH 4
+
+/* the number of new full vcs pending combination, and the number of
+ * combinations tried per update, which bounds the time spent in the
+ * engine on crowded boards
+ */
+#define HSEARCH_QUEUE_CAP 16384
+#define HSEARCH_MAX_WORK (4 * 1000 * 1000)
+
+/* the combinations tried between reads of the clock, when an update is
+ * bounded by a deadline
+ */
+#define HSEARCH_POLL_WORK 4096
+
+typedef u128 hsearch_set_t;
+
+struct hsearch_vcs {
+	hsearch_set_t full[HSEARCH_MAX_FULL];
+	hsearch_set_t semi[HSEARCH_MAX_SEMI];
+	u8 semi_key[HSEARCH_MAX_SEMI];
+	u8 full_len, semi_len;
+};
+
+struct hsearch_pending {
+	hsearch_set_t carrier;
+	u8 lhs, rhs;
+};
+
+struct hsearch {
+	u32 size, cells, nodes;
+	enum hex_player player;
+
+	/* the stones of the player and of the opponent */
+	hsearch_set_t own, other;
+
+	/* the vcs between every unordered pair of nodes, and for every node
+	 * the set of nodes it has at least one full vc with
+	 */
+	struct hsearch_vcs *vcs;
+	hsearch_set_t *linked;
+
+	struct hsearch_pending *queue;
+	u32 queue_head, queue_len;
+	u64 work;
+};
+
+inline hsearch_set_t
+hsearch_bit(u32 idx)
+{
+	return (hsearch_set_t) 1 << idx;
+}
+
+inline u32
+hsearch_source(struct hsearch const *self)
+{
+	return self->cells;
+}
+
+inline u32
+hsearch_sink(struct hsearch const *self)
+{
+	return self->cells + 1;
+}
+
+inline bool
+hsearch_supported(u32 size)
+{
+	return 0 < size && size <= HSEARCH_MAX_SIZE;
+}
+
+bool
+hsearch_init(struct hsearch *self, u32 size, enum hex_player player);
+
+void
+hsearch_free(struct hsearch *self);
+
+/* recomputes every vc from scratch for the position on the board */
+void
+hsearch_load(struct hsearch *self, struct board const *board);
+
+/* updates the vcs for a stone placed by either player, combining new vcs
+ * until the deadline (a monotonic timestamp in nanoseconds, or UINT64_MAX
+ * for no deadline) passes. vcs that are still pending then are dropped
+ */
+void
+hsearch_play(struct hsearch *self, enum hex_player player, u32 x, u32 y, u64 deadline);
+
+/* whether the player is connected between their edges (i.e. has won even
+ * with the opponent to move)
+ */
+bool
+hsearch_connected(struct hsearch const *self);
+
+/* the key of a semi vc between the player's edges, which wins the game
+ * for the player if it is their move
+ */
+bool
+hsearch_winning_move(struct hsearch const *self, u32 *out);
+
+/* the cells in which the opponent has to play to stop the player from
+ * connecting their edges, being the intersection of the carriers of every
+ * vc between the edges. returns false if the player has no such vc, and
+ * an empty set means the opponent has lost
+ */
+bool
+hsearch_mustplay(struct hsearch const *self, hsearch_set_t *out);
+
+/* whether every carrier and semi vc key is made of empty cells only, as
+ * every update has to keep them (for checking the engine)
+ */
+bool
+hsearch_carriers_empty(struct hsearch const *self);
+
+#endif /* HEXES_HSEARCH_H */
@@ -10,24 +10,48 @@ enum log_level {
 	LOG_DEBUG,
 };
 
-inline void
-dbglog(enum log_level log_level, char const *fmt, ...)
+/* log statements above this level are compiled out entirely, along with the
+ * evaluation of their arguments, so that release builds pay nothing for the
+ * debug logging on the search hot paths
+ */
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL LOG_DEBUG
+#endif
+
+/* messages at or below LOG_INFO are appended to an in-memory buffer, which is
+ * written out by a background thread once it is half full or once the flush
+ * interval has elapsed. errors and warnings flush the buffer immediately
+ */
+#define LOG_BUFFER_SIZE (64 * KiB)
+#define LOG_LINE_MAX 1024
+#define LOG_FLUSH_NANOS (50 * 1000 * 1000ULL)
+#define LOG_THREAD_STACK (64 * KiB)
+
+inline bool
+log_enabled(enum log_level log_level)
 {
-	if (opts.log_level < log_level) return;
+	return log_level <= opts.log_level;
+}
 
-	switch (log_level) {
-	case LOG_ERROR:	fputs("[ERROR]", stderr); break;
-	case LOG_WARN:	fputs("[WARN] ", stderr); break;
-	case LOG_INFO:	fputs("[INFO] ", stderr); break;
-	case LOG_DEBUG:	fputs("[DEBUG]", stderr); break;
-	}
+#define dbglog(level, ...)							\
+	do {									\
+		if ((level) <= LOG_COMPILE_LEVEL && log_enabled(level))		\
+			log_write((level), __VA_ARGS__);			\
+	} while (0)
 
-	fputc(' ', stderr);
+bool
+log_init(void);
 
-	va_list ap;
-	va_start(ap, fmt);
-	vfprintf(stderr, fmt, ap);
-	va_end(ap);
-}
+void
+log_flush(void);
+
+void
+log_write(enum log_level log_level, char const *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+/* writes a preformatted line to the sink as is, without a level prefix, for
+ * machine-readable output
+ */
+void
+log_record(char const *line, size_t len);
 
 #endif /* HEXES_LOG_H */
@@ -0,0 +1,24 @@
+#ifndef HEXES_MEMORY_H
+#define HEXES_MEMORY_H
+
+#include "hexes.h"
+
+#include <sys/resource.h>
+
+/* the memory counted against RLIMIT_DATA (private writable mappings, heap and
+ * stack), and the resident set, as reported by /proc/self/statm
+ */
+struct memory_usage {
+	size_t data, resident;
+};
+
+bool
+memory_usage(struct memory_usage *out);
+
+/* the number of bytes that may still be allocated under both the advertised
+ * limit and the actual RLIMIT_DATA of the process
+ */
+size_t
+memory_available(size_t advertised);
+
+#endif /* HEXES_MEMORY_H */
@@ -0,0 +1,95 @@
+#ifndef HEXES_PATTERN_H
+#define HEXES_PATTERN_H
+
+#include "hexes.h"
+
+/* the radius-1 neighbourhood of a cell is packed into a code of 2 bits per
+ * neighbour, with the neighbours ordered around the cell so that consecutive
+ * neighbours (and the first and last) are adjacent to each other. cells off
+ * the board read as the stones of the player owning that edge, and the cell
+ * beyond an obtuse corner (owned by neither edge) as a wall
+ */
+#define PATTERN_NEIGHBOURS 6
+#define PATTERN_CODES (1 << (2 * PATTERN_NEIGHBOURS))
+
+enum pattern_state {
+	PATTERN_EMPTY,
+	PATTERN_BLACK = 1 + HEX_PLAYER_BLACK,
+	PATTERN_WHITE = 1 + HEX_PLAYER_WHITE,
+	PATTERN_WALL,
+};
+
+typedef u16 pattern_code_t;
+
+extern s8 const pattern_dx[PATTERN_NEIGHBOURS];
+extern s8 const pattern_dy[PATTERN_NEIGHBOURS];
+
+/* a cell is dead when its colour can never matter to either player, which
+ * holds locally when, however its empty neighbours are filled, the
+ * neighbours of either colour always form a single chain around it (so that
+ * the cell joins nothing that is not already joined).
+ *
+ * a cell is one of the two carriers of a player's bridge when two of its
+ * neighbours (next but one to each other) are the player's, and the
+ * neighbour between them is empty. the bridge table holds, for each player,
+ * the directions of the empty carriers that save the player's bridges after
+ * an opponent stone on the cell
+ */
+struct pattern_tables {
+	bool dead[PATTERN_CODES];
+	u8 bridge[2][PATTERN_CODES];
+};
+
+extern struct pattern_tables pattern_tables;
+
+void
+pattern_init(void);
+
+inline enum pattern_state
+pattern_stone(enum hex_player player)
+{
+	return (enum pattern_state) (1 + player);
+}
+
+inline u32
+pattern_opposite(u32 dir)
+{
+	return (dir + PATTERN_NEIGHBOURS / 2) % PATTERN_NEIGHBOURS;
+}
+
+inline enum pattern_state
+pattern_get(pattern_code_t code, u32 dir)
+{
+	return (enum pattern_state) ((code >> (2 * dir)) & 3);
+}
+
+inline pattern_code_t
+pattern_set(pattern_code_t code, u32 dir, enum pattern_state state)
+{
+	return (pattern_code_t) ((code & ~(3 << (2 * dir))) | (state << (2 * dir)));
+}
+
+/* the state read for a neighbour at the given (off-board) coordinates */
+inline enum pattern_state
+pattern_edge(u32 size, s64 x, s64 y)
+{
+	bool off_x = x < 0 || x >= size, off_y = y < 0 || y >= size;
+
+	if (off_x && off_y) return PATTERN_WALL;
+
+	return off_x ? PATTERN_BLACK : PATTERN_WHITE;
+}
+
+inline bool
+pattern_dead(pattern_code_t code)
+{
+	return pattern_tables.dead[code];
+}
+
+inline u8
+pattern_bridge(pattern_code_t code, enum hex_player player)
+{
+	return pattern_tables.bridge[player][code];
+}
+
+#endif /* HEXES_PATTERN_H */
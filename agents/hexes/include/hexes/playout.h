@@ -0,0 +1,78 @@
+#ifndef HEXES_PLAYOUT_H
+#define HEXES_PLAYOUT_H
+
+#include "hexes.h"
+
+#include "hexes/bitboard.h"
+#include "hexes/board.h"
+
+/* a batch of playouts is simulated in parallel, one board per vector lane,
+ * with every word of the boards held in a single vector (so that lane l of
+ * vector w holds word w of the board for playout l)
+ */
+#if defined(__AVX512F__)
+#define PLAYOUT_VECTOR_BYTES 64
+#else
+#define PLAYOUT_VECTOR_BYTES 32
+#endif
+
+typedef u64 playout_lanes_t __attribute__((vector_size(PLAYOUT_VECTOR_BYTES)));
+
+#define PLAYOUT_LANES (PLAYOUT_VECTOR_BYTES / sizeof(u64))
+
+typedef u16 playout_mask_t;
+
+_Static_assert(PLAYOUT_LANES <= sizeof(playout_mask_t) * 8, "Playout lane mask too narrow");
+
+struct playout_batch {
+	u32 lanes;
+
+	/* lanes in which black won, and lanes in which each cell was owned by
+	 * each player at the end of the playout (for amaf statistics)
+	 */
+	playout_mask_t black_wins;
+	playout_mask_t owned[2][BITBOARD_MAX_SIZE * BITBOARD_MAX_SIZE];
+};
+
+inline playout_mask_t
+playout_batch_lanes(struct playout_batch const *self)
+{
+	return (playout_mask_t) ((1u << self->lanes) - 1);
+}
+
+inline playout_mask_t
+playout_batch_wins(struct playout_batch const *self, enum hex_player player)
+{
+	return player == HEX_PLAYER_BLACK
+	     ? self->black_wins
+	     : playout_batch_lanes(self) & ~self->black_wins;
+}
+
+typedef void (*playout_batch_fn)(struct bitboard const *board, enum hex_player player,
+				 struct move *moves, size_t len, struct playout_batch *out);
+
+/* random playouts fill the board in a uniformly random order, while bridge
+ * playouts also answer every move into a bridge of the opponent with the
+ * other carrier of that bridge (found from the neighbourhood of the move)
+ */
+enum playout_policy {
+	PLAYOUT_POLICY_RANDOM,
+	PLAYOUT_POLICY_BRIDGE,
+};
+
+bool
+playout_policy_parse(char const *str, enum playout_policy *out);
+
+char const *
+playout_policy_str(enum playout_policy policy);
+
+/* returns the playout kernel for the given policy specialised for boards of
+ * the given size, or the generic kernel if the size has no specialisation
+ */
+playout_batch_fn
+playout_batch_kernel(u32 size, enum playout_policy policy);
+
+void
+playout_batch_terminal(struct bitboard const *board, enum hex_player winner, struct playout_batch *out);
+
+#endif /* HEXES_PLAYOUT_H */
@@ -0,0 +1,95 @@
+#ifndef HEXES_RNG_H
+#define HEXES_RNG_H
+
+#include "hexes.h"
+
+/* xoshiro256** with per-thread state, so that threads never contend on a
+ * shared generator (as they do on the global lock taken by libc random()).
+ * every thread that draws numbers must seed its own state first
+ */
+struct rng {
+	u64 s[4];
+};
+
+extern _Thread_local struct rng rng_state;
+
+inline u64
+rng_splitmix64(u64 *state)
+{
+	u64 z = (*state += 0x9e3779b97f4a7c15ULL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+inline u64
+rng_rotl(u64 x, u32 k)
+{
+	return (x << k) | (x >> (64 - k));
+}
+
+inline u64
+rng_next(void)
+{
+	u64 *s = rng_state.s;
+
+	u64 result = rng_rotl(s[1] * 5, 7) * 9;
+	u64 t = s[1] << 17;
+
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
+
+	s[2] ^= t;
+	s[3] = rng_rotl(s[3], 45);
+
+	return result;
+}
+
+/* maps a 32-bit draw onto [0, bound) without modulo bias (lemire's nearly
+ * divisionless method), drawing again in the rare case of a rejection
+ */
+inline u32
+rng_bounded_from(u32 draw, u32 bound)
+{
+	assert(bound);
+
+	u64 m = (u64) draw * bound;
+
+	if ((u32) m < bound) {
+		u32 threshold = -bound % bound;
+
+		while ((u32) m < threshold)
+			m = (u64) (u32) (rng_next() >> 32) * bound;
+	}
+
+	return (u32) (m >> 32);
+}
+
+inline u32
+rng_bounded(u32 bound)
+{
+	return rng_bounded_from((u32) (rng_next() >> 32), bound);
+}
+
+void
+rng_seed(u64 seed);
+
+/* a bulk generator running RNG_LANES independent xoshiro256** streams in
+ * parallel vector lanes, for filling buffers of draws (e.g. for playouts)
+ */
+#define RNG_LANES 4
+
+typedef u64 rng_lanes_t __attribute__((vector_size(RNG_LANES * sizeof(u64))));
+
+struct rng_bulk {
+	rng_lanes_t s[4];
+};
+
+extern _Thread_local struct rng_bulk rng_bulk_state;
+
+void
+rng_fill(u32 *buf, size_t len);
+
+#endif /* HEXES_RNG_H */
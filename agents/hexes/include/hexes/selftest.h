@@ -0,0 +1,52 @@
+#ifndef HEXES_SELFTEST_H
+#define HEXES_SELFTEST_H
+
+#include "hexes.h"
+
+#include "hexes/board.h"
+
+/* the self-test checks the solvers and pruning against an exhaustive
+ * search, which is only feasible on the smallest boards
+ */
+#define SELFTEST_MAX_SIZE 5
+#define SELFTEST_MAX_CELLS (SELFTEST_MAX_SIZE * SELFTEST_MAX_SIZE)
+
+/* positions with more empty cells than this are redrawn, as searching them
+ * exhaustively takes too long
+ */
+#define SELFTEST_MAX_EMPTY 12
+#define SELFTEST_DEFAULT_SEED 0x6865786573ULL
+
+/* positions searched by the exhaustive solver are remembered in a single,
+ * always-replacing table, keyed by the zobrist hash and player to move
+ */
+#define SELFTEST_SOLVER_ENTRIES (1 << 20)
+
+/* positions checked per check, and the memory given to the endgame solver */
+#define SELFTEST_DFPN_POSITIONS 400
+#define SELFTEST_DFPN_MIB 16
+
+/* the inferior cell patterns are checked on positions of both sizes, with
+ * every position crowded enough to be searched exhaustively
+ */
+#define SELFTEST_PATTERN_POSITIONS 1000
+#define SELFTEST_PATTERN_STONES 4
+#define SELFTEST_PATTERN_LARGE_POSITIONS 200
+#define SELFTEST_PATTERN_LARGE_STONES 13
+
+/* the virtual connection engine is checked on 4x4 positions reached by a
+ * few random moves, so that its connections are not all trivial, and on
+ * crowded 5x5 positions
+ */
+#define SELFTEST_HSEARCH_POSITIONS 400
+#define SELFTEST_HSEARCH_STONES 5
+#define SELFTEST_HSEARCH_LARGE_POSITIONS 200
+#define SELFTEST_HSEARCH_LARGE_STONES 13
+
+/* runs the self-test, taking the arguments following the selftest
+ * subcommand, and returns whether every check passed
+ */
+bool
+selftest_run(int argc, char **argv);
+
+#endif /* HEXES_SELFTEST_H */
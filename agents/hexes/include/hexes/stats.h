@@ -0,0 +1,122 @@
+#ifndef HEXES_STATS_H
+#define HEXES_STATS_H
+
+#include "hexes.h"
+
+/* search instrumentation is compiled in unless disabled explicitly, or by a
+ * release build, in which case every hook below is an empty inline function
+ * and the counters cost nothing
+ */
+#ifndef HEXES_STATS
+#ifdef NDEBUG
+#define HEXES_STATS 0
+#else
+#define HEXES_STATS 1
+#endif
+#endif
+
+enum stats_phase {
+	STATS_SELECT,
+	STATS_EXPAND,
+	STATS_SIMULATE,
+	STATS_BACKPROP,
+	_STATS_PHASE_COUNT,
+};
+
+/* selection depths past the last bucket are counted in the last bucket */
+#define STATS_DEPTH_BUCKETS 32
+
+struct stats {
+	u64 start;
+	u64 cycles[_STATS_PHASE_COUNT];
+
+	u64 rounds, nodes, playouts, playout_moves;
+	u64 depth[STATS_DEPTH_BUCKETS];
+	u32 max_depth;
+};
+
+/* the pool occupancy at the end of a search, of which the free bytes are
+ * recycled nodes and blocks waiting on a free list
+ */
+struct stats_pool {
+	size_t used, free, committed;
+};
+
+/* a cheap timestamp for attributing time to search phases, in cycles where
+ * the target has a cycle counter and in nanoseconds where it does not
+ */
+inline u64
+stats_cycles(void)
+{
+#if !HEXES_STATS
+	return 0;
+#elif defined(__x86_64__) || defined(__i386__)
+	return __builtin_ia32_rdtsc();
+#else
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return TIMESPEC_TO_NANOS(now.tv_sec, now.tv_nsec);
+#endif
+}
+
+inline void
+stats_reset(struct stats *self)
+{
+	assert(self);
+
+#if HEXES_STATS
+	memset(self, 0, sizeof *self);
+	self->start = stats_cycles();
+#else
+	(void) self;
+#endif
+}
+
+/* charges the time since start to the given phase, returning the start of
+ * the next phase
+ */
+inline u64
+stats_phase(struct stats *self, enum stats_phase phase, u64 start)
+{
+	assert(self);
+
+#if HEXES_STATS
+	u64 now = stats_cycles();
+	self->cycles[phase] += now - start;
+
+	return now;
+#else
+	(void) self;
+	(void) phase;
+	return start;
+#endif
+}
+
+inline void
+stats_round(struct stats *self, u32 depth, bool expanded, u32 playouts, u32 playout_moves)
+{
+	assert(self);
+
+#if HEXES_STATS
+	self->rounds++;
+	self->nodes += expanded;
+	self->playouts += playouts;
+	self->playout_moves += (u64) playouts * playout_moves;
+
+	self->depth[depth < STATS_DEPTH_BUCKETS ? depth : STATS_DEPTH_BUCKETS - 1]++;
+	if (depth > self->max_depth) self->max_depth = depth;
+#else
+	(void) self;
+	(void) depth;
+	(void) expanded;
+	(void) playouts;
+	(void) playout_moves;
+#endif
+}
+
+/* writes the counters as a single json object on its own line */
+void
+stats_report(struct stats const *self, char const *label, u64 elapsed_nanos, struct stats_pool const *pool);
+
+#endif /* HEXES_STATS_H */
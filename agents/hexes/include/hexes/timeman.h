@@ -0,0 +1,81 @@
+#ifndef HEXES_TIMEMAN_H
+#define HEXES_TIMEMAN_H
+
+#include "hexes.h"
+
+/* time held back once from the remaining game time, to cover network
+ * latency (the work done around the search is charged as it happens)
+ */
+#define TIMEMAN_RESERVE_NANOS (100 * 1000 * 1000ULL)
+
+/* the smallest budget ever handed out, so that a search always has time
+ * for at least a few rounds
+ */
+#define TIMEMAN_MIN_NANOS (1000 * 1000ULL)
+
+/* the number of own moves assumed to remain even near the end of the game,
+ * as games rarely fill the board (and a badly played endgame loses anyway)
+ */
+#define TIMEMAN_MIN_MOVES 6
+
+/* a search may overrun its soft budget up to TIMEMAN_EXTENSION times when
+ * the best root move is not yet clear, but never spends more than
+ * 1/TIMEMAN_HARD_FRACTION of the remaining time on a single move
+ */
+#define TIMEMAN_EXTENSION 3
+#define TIMEMAN_HARD_FRACTION 4
+
+/* the deadline is only polled every so many rounds, with the interval tuned
+ * so that polls are spaced roughly TIMEMAN_POLL_NANOS apart
+ */
+#define TIMEMAN_POLL_NANOS (1000 * 1000ULL)
+
+struct timeman_budget {
+	/* nanoseconds from the start of the search after which the search
+	 * should stop (soft), and after which it must stop (hard)
+	 */
+	u64 soft, hard;
+
+	/* if nonzero, the number of search rounds after which the search
+	 * stops regardless of the time taken, for reproducible benchmarks
+	 */
+	size_t rounds;
+};
+
+struct timeman_budget
+timeman_allocate(struct timespec const *remaining, size_t empty_cells, size_t total_cells);
+
+inline u64
+timeman_now(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return TIMESPEC_TO_NANOS(now.tv_sec, now.tv_nsec);
+}
+
+/* a deadline that reads the clock only once every interval polls, keeping
+ * the cost of a poll to a decrement in the common case
+ */
+struct timeman_deadline {
+	u64 start, soft, hard, last;
+	u32 interval, countdown;
+};
+
+void
+timeman_deadline_init(struct timeman_deadline *self, struct timeman_budget const *budget);
+
+u64
+timeman_deadline_read(struct timeman_deadline *self);
+
+/* returns true when the clock was read, storing the elapsed time in out */
+inline bool
+timeman_deadline_poll(struct timeman_deadline *self, u64 *out)
+{
+	if (--self->countdown) return false;
+
+	*out = timeman_deadline_read(self) - self->start;
+	return true;
+}
+
+#endif /* HEXES_TIMEMAN_H */
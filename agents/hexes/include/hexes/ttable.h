@@ -0,0 +1,82 @@
+#ifndef HEXES_TTABLE_H
+#define HEXES_TTABLE_H
+
+#include "hexes.h"
+
+#include <stdatomic.h>
+
+/* a fixed-size transposition table, shared between searches without locks.
+ *
+ * every entry stores a 64-bit payload alongside the position hash xor'ed with
+ * that payload, so that an entry torn by concurrent writers fails to verify
+ * and reads as a miss. the low bits of the check word hold the replacement
+ * priority of the entry (e.g. search depth for alpha-beta, or a logarithm of
+ * the visit count for mcts), and are excluded from verification
+ */
+#define TTABLE_BUCKET_ENTRIES 4
+#define TTABLE_PRIORITY_BITS 8
+#define TTABLE_PRIORITY_MASK ((u64) ((1 << TTABLE_PRIORITY_BITS) - 1))
+
+struct ttable_entry {
+	_Atomic u64 check, data;
+};
+
+/* a bucket fills exactly one cache line */
+struct ttable_bucket {
+	alignas(64) struct ttable_entry entries[TTABLE_BUCKET_ENTRIES];
+};
+
+_Static_assert(sizeof(struct ttable_bucket) == 64, "Transposition table bucket must fill a cache line");
+
+struct ttable {
+	struct ttable_bucket *buckets;
+	size_t mask;
+};
+
+bool
+ttable_init(struct ttable *self, size_t capacity);
+
+void
+ttable_free(struct ttable *self);
+
+void
+ttable_clear(struct ttable *self);
+
+bool
+ttable_probe(struct ttable *self, u64 hash, u64 *out);
+
+void
+ttable_store(struct ttable *self, u64 hash, u64 data, u8 priority);
+
+/* the bytes actually allocated, which the rounding down to a power-of-two
+ * number of buckets leaves at most the capacity given to ttable_init()
+ */
+inline size_t
+ttable_size(struct ttable const *self)
+{
+	return (self->mask + 1) * sizeof *self->buckets;
+}
+
+/* mcts statistics are packed as a (signed) win count and a play count, with
+ * the priority of an entry growing with the logarithm of its play count
+ */
+inline u64
+ttable_pack_stats(s32 wins, u32 plays)
+{
+	return ((u64) (u32) wins << 32) | plays;
+}
+
+inline void
+ttable_unpack_stats(u64 data, s32 *wins, u32 *plays)
+{
+	*wins = (s32) (u32) (data >> 32);
+	*plays = (u32) data;
+}
+
+inline u8
+ttable_stats_priority(u32 plays)
+{
+	return plays ? (u8) (32 - __builtin_clz(plays)) : 0;
+}
+
+#endif /* HEXES_TTABLE_H */
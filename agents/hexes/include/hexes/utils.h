@@ -3,39 +3,44 @@
 
 #include "hexes.h"
 
-inline void
-swap(void *restrict lhs, void *restrict rhs, size_t size)
-{
-	assert(lhs);
-	assert(rhs);
-	assert(size);
-
-	u8 tmp[size];
-
-	memcpy(tmp, rhs, size);
-	memcpy(rhs, lhs, size);
-	memcpy(lhs, tmp, size);
-}
-
-inline void
-shuffle(void *arr, size_t size, size_t len)
-{
-	assert(arr);
-	assert(size);
-
-	for (size_t i = 0; i < len - 2; i++) {
-		size_t j = (i + random()) % len;
-
-		swap((u8 *) arr + (i * size),
-		     (u8 *) arr + (j * size),
-		     size);
-	}
-}
+#include "hexes/rng.h"
+
+#include <stdatomic.h>
+
+/* swaps two lvalues of the same type */
+#define SWAP(lhs, rhs) \
+	do { \
+		__typeof__(lhs) swap_tmp_ = (lhs); \
+		(lhs) = (rhs); \
+		(rhs) = swap_tmp_; \
+	} while (0)
+
+/* unbiased fisher-yates shuffle of a typed array, drawing from the calling
+ * thread's generator
+ */
+#define SHUFFLE(arr, len) \
+	do { \
+		for (size_t shuffle_i_ = (len); shuffle_i_ > 1; shuffle_i_--) { \
+			size_t shuffle_j_ = rng_bounded((u32) shuffle_i_); \
+			SWAP((arr)[shuffle_i_ - 1], (arr)[shuffle_j_]); \
+		} \
+	} while (0)
+
+/* as SHUFFLE, but taking the (len - 1) raw draws from a buffer filled in bulk
+ * beforehand, such as by rng_fill()
+ */
+#define SHUFFLE_DRAWS(arr, len, draws) \
+	do { \
+		for (size_t shuffle_i_ = (len); shuffle_i_ > 1; shuffle_i_--) { \
+			size_t shuffle_j_ = rng_bounded_from((draws)[shuffle_i_ - 2], (u32) shuffle_i_); \
+			SWAP((arr)[shuffle_i_ - 1], (arr)[shuffle_j_]); \
+		} \
+	} while (0)
 
 inline void
 difftimespec(struct timespec *restrict lhs, struct timespec *restrict rhs, struct timespec *restrict out)
 {
-	if (lhs->tv_sec <= rhs->tv_sec && lhs->tv_nsec < rhs->tv_nsec) {
+	if (lhs->tv_sec < rhs->tv_sec || (lhs->tv_sec == rhs->tv_sec && lhs->tv_nsec < rhs->tv_nsec)) {
 		out->tv_sec = 0;
 		out->tv_nsec = 0;
 	} else {
@@ -44,9 +49,27 @@ difftimespec(struct timespec *restrict lhs, struct timespec *restrict rhs, struc
 	}
 }
 
+/* pools reserve an anonymous mapping aligned to (and sized in) huge pages,
+ * without access rights so that it does not count against RLIMIT_DATA, and
+ * commit it in chunks as it fills up. committed memory is only backed once
+ * first touched, and the kernel is asked to back it with transparent huge
+ * pages, to cut down on tlb misses
+ */
+#define MEM_POOL_HUGEPAGE_SIZE (2 * MiB)
+#define MEM_POOL_CHUNK_SIZE (16 * MiB)
+
+_Static_assert(MEM_POOL_CHUNK_SIZE % MEM_POOL_HUGEPAGE_SIZE == 0, "Pool chunks must be whole huge pages");
+
+#ifndef MADV_POPULATE_WRITE
+#define MADV_POPULATE_WRITE 23
+#endif
+
 struct mem_pool {
 	void *ptr;
-	size_t cap, len;
+	size_t cap, len, mapped;
+
+	/* grown by whichever thread needs more memory first */
+	_Atomic size_t committed;
 };
 
 inline bool
@@ -55,13 +78,35 @@ mem_pool_init(struct mem_pool *self, size_t align, size_t capacity)
 	assert(self);
 	assert(align);
 	assert(align % 2 == 0);
+	assert(align <= MEM_POOL_HUGEPAGE_SIZE);
 	assert(capacity % align == 0);
+	(void) align;
 
-	self->ptr = aligned_alloc(align, capacity);
-	if (!self->ptr) return false;
+	size_t hugepage_mask = MEM_POOL_HUGEPAGE_SIZE - 1;
+	size_t mapped = (capacity + hugepage_mask) & ~hugepage_mask;
 
+	/* we over-reserve by a huge page, and trim the mapping to the first
+	 * huge page boundary within it
+	 */
+	u8 *map = mmap(NULL, mapped + MEM_POOL_HUGEPAGE_SIZE, PROT_NONE,
+		       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (map == MAP_FAILED) return false;
+
+	u8 *ptr = (u8 *) (((uintptr_t) map + hugepage_mask) & ~(uintptr_t) hugepage_mask);
+	size_t head = ptr - map, tail = MEM_POOL_HUGEPAGE_SIZE - head;
+
+	if (head) munmap(map, head);
+	if (tail) munmap(ptr + mapped, tail);
+
+	/* huge pages are merely an optimisation, so failure is not an error */
+	madvise(ptr, mapped, MADV_HUGEPAGE);
+
+	self->ptr = ptr;
 	self->cap = capacity;
 	self->len = 0;
+	self->mapped = mapped;
+
+	atomic_init(&self->committed, 0);
 
 	return true;
 }
@@ -71,7 +116,52 @@ mem_pool_free(struct mem_pool *self)
 {
 	assert(self);
 
-	free(self->ptr);
+	munmap(self->ptr, self->mapped);
+}
+
+/* commits whole chunks until at least end bytes of the pool are usable,
+ * failing once the process runs into its data limit
+ */
+inline bool
+mem_pool_commit(struct mem_pool *self, size_t end)
+{
+	assert(self);
+
+	if (end > self->mapped) return false;
+
+	size_t committed = atomic_load_explicit(&self->committed, memory_order_acquire);
+	while (committed < end) {
+		size_t next = committed + MEM_POOL_CHUNK_SIZE;
+		if (next > self->mapped) next = self->mapped;
+
+		/* granting access to a range twice is harmless, so racing
+		 * threads need only agree on the new size
+		 */
+		if (mprotect((u8 *) self->ptr + committed, next - committed, PROT_READ | PROT_WRITE))
+			return false;
+
+		atomic_compare_exchange_weak_explicit(&self->committed, &committed, next,
+						      memory_order_acq_rel, memory_order_acquire);
+	}
+
+	return true;
+}
+
+/* commits and faults in (without modifying) the given range of the pool, so
+ * that it is safe to call while the pool is in use by another thread
+ */
+inline bool
+mem_pool_populate(struct mem_pool *self, size_t offset, size_t len)
+{
+	assert(self);
+	assert(offset % MEM_POOL_HUGEPAGE_SIZE == 0);
+
+	if (offset >= self->mapped) return true;
+	if (len > self->mapped - offset) len = self->mapped - offset;
+
+	if (!mem_pool_commit(self, offset + len)) return false;
+
+	return madvise((u8 *) self->ptr + offset, len, MADV_POPULATE_WRITE) == 0;
 }
 
 inline void
@@ -94,6 +184,10 @@ mem_pool_alloc(struct mem_pool *self, size_t align, size_t size)
 
 	if (aligned_len + size >= self->cap) return NULL;
 
+	if (aligned_len + size > atomic_load_explicit(&self->committed, memory_order_relaxed)
+	    && !mem_pool_commit(self, aligned_len + size))
+		return NULL;
+
 	void *ptr = (u8 *) self->ptr + aligned_len;
 	self->len = aligned_len + size;
 
@@ -0,0 +1,43 @@
+#ifndef HEXES_ZOBRIST_H
+#define HEXES_ZOBRIST_H
+
+#include "hexes.h"
+
+#include "hexes/board.h"
+
+#define ZOBRIST_MAX_CELLS (BOARD_MAX_SIZE * BOARD_MAX_SIZE)
+
+/* the keys are generated from a fixed seed, so that hashes are reproducible
+ * between runs (and between agents sharing a transposition table format)
+ */
+#define ZOBRIST_SEED 0x9e3779b97f4a7c15ULL
+
+struct zobrist {
+	u64 cells[2][ZOBRIST_MAX_CELLS];
+
+	/* the player that made the last move, as the same stones can be
+	 * reached with either player to move once the board has been swapped
+	 */
+	u64 turn[2];
+};
+
+extern struct zobrist zobrist;
+
+void
+zobrist_init(void);
+
+inline u64
+zobrist_cell(enum hex_player player, u32 idx)
+{
+	assert(idx < ZOBRIST_MAX_CELLS);
+
+	return zobrist.cells[player][idx];
+}
+
+inline u64
+zobrist_turn(enum hex_player player)
+{
+	return zobrist.turn[player];
+}
+
+#endif /* HEXES_ZOBRIST_H */
@@ -54,16 +54,38 @@ agent_swap(struct agent *self)
 	}
 }
 
+void
+agent_ponder_start(struct agent *self)
+{
+	assert(self);
+
+	switch (self->type) {
+	case AGENT_RANDOM:	break;
+	case AGENT_MCTS:	agent_mcts_ponder_start(&self->backend.mcts); break;
+	}
+}
+
+void
+agent_ponder_stop(struct agent *self)
+{
+	assert(self);
+
+	switch (self->type) {
+	case AGENT_RANDOM:	break;
+	case AGENT_MCTS:	agent_mcts_ponder_stop(&self->backend.mcts); break;
+	}
+}
+
 bool
-agent_next(struct agent *self, struct timespec timeout, u32 *out_x, u32 *out_y)
+agent_next(struct agent *self, struct timeman_budget const *budget, u32 *out_x, u32 *out_y)
 {
 	assert(self);
 	assert(out_x);
 	assert(out_y);
 
 	switch (self->type) {
-	case AGENT_RANDOM:	return agent_random_next(&self->backend.random, timeout, out_x, out_y);
-	case AGENT_MCTS:	return agent_mcts_next(&self->backend.mcts, timeout, out_x, out_y);
+	case AGENT_RANDOM:	return agent_random_next(&self->backend.random, budget, out_x, out_y);
+	case AGENT_MCTS:	return agent_mcts_next(&self->backend.mcts, budget, out_x, out_y);
 	}
 
 	return false;
@@ -1,254 +1,1307 @@
 #include "hexes/agent/mcts.h"
 
+#if defined(__SSE__)
+#include <immintrin.h>
+#endif
+
+extern inline mcts_ref_t
+mcts_ref(void const *base, void const *absptr);
+
+extern inline void *
+mcts_deref(void const *base, mcts_ref_t ref);
+
 extern inline size_t
-mcts_node_sizeof(size_t children);
+mcts_block_sizeof(size_t cap);
 
-extern inline mcts_node_relptr_t
-mcts_node_abs2rel(void *base, struct mcts_node *absptr);
+extern inline size_t
+mcts_block_class(size_t cap);
 
-extern inline struct mcts_node *
-mcts_node_rel2abs(void *base, mcts_node_relptr_t relptr);
+extern inline struct mcts_children
+mcts_block_children(struct mcts_block *self);
 
 static void
-mcts_node_init(struct mcts_node *self, struct mcts_node *parent,
-	       enum hex_player player, u8 x, u8 y, size_t children)
+mcts_node_init(struct mcts_node *self, struct mcts_node *parent, void const *base,
+	       enum hex_player player, u8 x, u8 y, size_t moves)
 {
 	assert(self);
 
-	self->parent = mcts_node_abs2rel(self, parent);
-	self->player = player;
+	self->parent = mcts_ref(base, parent);
+	self->block = MCTS_REF_NULL;
+	self->plays = 0;
+
+	self->index = 0;
+	self->moves = moves;
+	self->children_len = 0;
+
 	self->x = x;
 	self->y = y;
+	self->player = player;
+	self->proof = MCTS_PROOF_NONE;
+}
+
+static void *
+mcts_alloc(struct agent_mcts *agent, mcts_ref_t *free_list, size_t size)
+{
+	assert(agent);
+	assert(free_list);
+
+	/* prefer a recycled allocation of the same size class, and only then
+	 * fresh pool memory
+	 */
+	void *ptr;
+	if ((ptr = mcts_deref(agent->pool.ptr, *free_list))) {
+		memcpy(free_list, ptr, sizeof *free_list);
+		return ptr;
+	}
+
+	return mem_pool_alloc(&agent->pool, MCTS_POOL_ALIGN, size);
+}
+
+static void
+mcts_release(struct agent_mcts *agent, mcts_ref_t *free_list, void *ptr)
+{
+	assert(agent);
+	assert(free_list);
+	assert(ptr);
+
+	memcpy(ptr, free_list, sizeof *free_list);
+	*free_list = mcts_ref(agent->pool.ptr, ptr);
+}
+
+static struct mcts_block *
+mcts_block_alloc(struct agent_mcts *agent, size_t class)
+{
+	assert(agent);
+	assert(class < MCTS_BLOCK_CLASSES);
+
+	size_t cap = (size_t) MCTS_BLOCK_MIN_CAP << class;
+
+	/* the free list is linked through the first word of a block, so the
+	 * capacity has to be restored on reuse
+	 */
+	struct mcts_block *block = mcts_alloc(agent, &agent->free_blocks[class], mcts_block_sizeof(cap));
+	if (block) block->cap = cap;
+
+	return block;
+}
+
+static void
+mcts_node_release(struct mcts_node *self, struct agent_mcts *agent)
+{
+	assert(self);
+	assert(agent);
+
+	struct mcts_block *block = mcts_deref(agent->pool.ptr, self->block);
+	if (block) {
+		agent->reclaimed_bytes += mcts_block_sizeof(block->cap);
+		mcts_release(agent, &agent->free_blocks[mcts_block_class(block->cap)], block);
+	}
+
+	agent->reclaimed_nodes += 1;
+	agent->reclaimed_bytes += sizeof *self;
+
+	mcts_release(agent, &agent->free_nodes, self);
+}
+
+static bool
+mcts_node_reserve(struct mcts_node *self, struct agent_mcts *agent)
+{
+	assert(self);
+	assert(agent);
+
+	struct mcts_block *block = mcts_deref(agent->pool.ptr, self->block);
+	if (block && self->children_len < block->cap) return true;
+
+	/* the child block is full (or missing), so we move the children into a
+	 * block of the next size class. the children keep their slots, so only
+	 * the node's reference to its block has to change
+	 */
+	size_t class = block ? mcts_block_class(block->cap) + 1 : 0;
+
+	struct mcts_block *grown = mcts_block_alloc(agent, class);
+	if (!grown) return false;
+
+	if (block) {
+		struct mcts_children src = mcts_block_children(block);
+		struct mcts_children dst = mcts_block_children(grown);
+
+		size_t len = self->children_len;
+		memcpy(dst.nodes, src.nodes, len * sizeof *dst.nodes);
+		memcpy(dst.wins, src.wins, len * sizeof *dst.wins);
+		memcpy(dst.plays, src.plays, len * sizeof *dst.plays);
+		memcpy(dst.rave_wins, src.rave_wins, len * sizeof *dst.rave_wins);
+		memcpy(dst.rave_plays, src.rave_plays, len * sizeof *dst.rave_plays);
+		memcpy(dst.cells, src.cells, len * sizeof *dst.cells);
+		memcpy(dst.proofs, src.proofs, len * sizeof *dst.proofs);
+
+		mcts_release(agent, &agent->free_blocks[class - 1], block);
+	}
+
+	self->block = mcts_ref(agent->pool.ptr, grown);
+
+	return true;
+}
+
+static struct mcts_node *
+mcts_node_expand(struct mcts_node *self, struct agent_mcts *agent, u8 x, u8 y, size_t moves)
+{
+	assert(self);
+	assert(agent);
+	assert(self->children_len < self->moves);
+
+	if (!mcts_node_reserve(self, agent)) {
+		dbglog(LOG_DEBUG, "Failed to allocate child block. Reclaiming low-visit subtrees\n");
+		return NULL;
+	}
+
+	struct mcts_node *child = mcts_alloc(agent, &agent->free_nodes, sizeof *child);
+
+	if (!child) {
+		dbglog(LOG_DEBUG, "Failed to allocate child node. Reclaiming low-visit subtrees\n");
+		return NULL;
+	}
+
+	mcts_node_init(child, self, agent->pool.ptr, hexopponent(self->player), x, y, moves);
+
+	struct mcts_block *block = mcts_deref(agent->pool.ptr, self->block);
+	struct mcts_children children = mcts_block_children(block);
+
+	size_t idx = self->children_len++;
+	child->index = idx;
+
+	children.nodes[idx] = mcts_ref(agent->pool.ptr, child);
+	children.wins[idx] = children.rave_wins[idx] = 0;
+	children.plays[idx] = children.rave_plays[idx] = 0;
+	children.cells[idx] = y * agent->geometry.size + x;
+	children.proofs[idx] = MCTS_PROOF_NONE;
+
+	return child;
+}
+
+static void
+mcts_node_remove_child(struct mcts_node *self, struct agent_mcts *agent, size_t idx)
+{
+	assert(self);
+	assert(agent);
+	assert(idx < self->children_len);
+
+	struct mcts_block *block = mcts_deref(agent->pool.ptr, self->block);
+	struct mcts_children children = mcts_block_children(block);
+
+	size_t last = --self->children_len;
+	if (idx != last) {
+		children.nodes[idx] = children.nodes[last];
+		children.wins[idx] = children.wins[last];
+		children.plays[idx] = children.plays[last];
+		children.rave_wins[idx] = children.rave_wins[last];
+		children.rave_plays[idx] = children.rave_plays[last];
+		children.cells[idx] = children.cells[last];
+		children.proofs[idx] = children.proofs[last];
+
+		struct mcts_node *moved = mcts_deref(agent->pool.ptr, children.nodes[idx]);
+		moved->index = idx;
+	}
+
+	children.nodes[last] = MCTS_REF_NULL;
+
+	/* a node whose children have all been reclaimed is a leaf again, and
+	 * leaves carry no child block
+	 */
+	if (!self->children_len) {
+		agent->reclaimed_bytes += mcts_block_sizeof(block->cap);
+		mcts_release(agent, &agent->free_blocks[mcts_block_class(block->cap)], block);
+
+		self->block = MCTS_REF_NULL;
+	}
+}
+
+static void
+mcts_node_release_subtree(struct mcts_node *self, struct agent_mcts *agent)
+{
+	assert(self);
+	assert(agent);
+
+	if (self->children_len) {
+		struct mcts_block *block = mcts_deref(agent->pool.ptr, self->block);
+
+		for (size_t i = 0; i < self->children_len; i++)
+			mcts_node_release_subtree(mcts_deref(agent->pool.ptr, block->nodes[i]), agent);
+	}
+
+	mcts_node_release(self, agent);
+}
+
+static void
+mcts_node_reclaim(struct mcts_node *self, struct agent_mcts *agent, u32 threshold)
+{
+	assert(self);
+	assert(agent);
+
+	/* we reclaim bottom-up, so that a child with few enough plays is
+	 * released together with its entire subtree (as no descendant can have
+	 * been played more often than its ancestor)
+	 */
+	for (size_t i = 0; i < self->children_len; /* nop */) {
+		struct mcts_block *block = mcts_deref(agent->pool.ptr, self->block);
+		struct mcts_node *child = mcts_deref(agent->pool.ptr, block->nodes[i]);
+		assert(child);
+
+		mcts_node_reclaim(child, agent, threshold);
+
+		/* proven children are kept, as they cost little and would only
+		 * have to be proven again
+		 */
+		if (child->children_len || child->plays > threshold || child->proof) {
+			i++;
+			continue;
+		}
+
+		mcts_node_remove_child(self, agent, i);
+		mcts_node_release(child, agent);
+	}
+}
+
+static void
+mcts_node_release_filled(struct mcts_node *self, struct agent_mcts *agent, bool const *filled)
+{
+	assert(self);
+	assert(agent);
+	assert(filled);
+
+	for (size_t i = 0; i < self->children_len; /* nop */) {
+		struct mcts_block *block = mcts_deref(agent->pool.ptr, self->block);
+		struct mcts_children children = mcts_block_children(block);
+		struct mcts_node *child = mcts_deref(agent->pool.ptr, children.nodes[i]);
+
+		if (!filled[children.cells[i]]) {
+			mcts_node_release_filled(child, agent, filled);
+			i++;
+			continue;
+		}
+
+		mcts_node_remove_child(self, agent, i);
+		mcts_node_release_subtree(child, agent);
+	}
+}
+
+static struct mcts_node *
+mcts_node_get_child(struct mcts_node *self, struct agent_mcts *agent, u16 cell)
+{
+	assert(self);
+	assert(agent);
+
+	if (!self->children_len) return NULL;
+
+	struct mcts_block *block = mcts_deref(agent->pool.ptr, self->block);
+	struct mcts_children children = mcts_block_children(block);
+
+	for (size_t i = 0; i < self->children_len; i++) {
+		if (children.cells[i] == cell) return mcts_deref(agent->pool.ptr, children.nodes[i]);
+	}
+
+	return NULL;
+}
+
+/* settles the value of a node, and of as many of its ancestors as follow
+ * from it by minimax: a won move loses the position before it, and a lost
+ * move only wins that position once every other move from it is lost too
+ */
+static void
+mcts_node_prove(struct mcts_node *self, struct agent_mcts *agent, enum mcts_proof proof)
+{
+	assert(self);
+	assert(agent);
+
+	while (true) {
+		self->proof = proof;
+
+		struct mcts_node *parent = mcts_deref(agent->pool.ptr, self->parent);
+		if (!parent) return;
+
+		struct mcts_children siblings = mcts_block_children(mcts_deref(agent->pool.ptr, parent->block));
+		siblings.proofs[self->index] = proof;
+
+		if (proof == MCTS_PROOF_LOSS) {
+			if (parent->children_len < parent->moves) return;
+
+			for (size_t i = 0; i < parent->children_len; i++) {
+				if (siblings.proofs[i] != MCTS_PROOF_LOSS) return;
+			}
+		}
+
+		proof = proof == MCTS_PROOF_WIN ? MCTS_PROOF_LOSS : MCTS_PROOF_WIN;
+		self = parent;
+	}
+}
+
+/* children are scored a whole vector at a time, using the widest vectors
+ * for which we have a square root instruction
+ */
+#if defined(__AVX__)
+#define MCTS_SCORE_BYTES 32
+#else
+#define MCTS_SCORE_BYTES 16
+#endif
+
+typedef f32 mcts_score_t __attribute__((vector_size(MCTS_SCORE_BYTES)));
+typedef s32 mcts_score_mask_t __attribute__((vector_size(MCTS_SCORE_BYTES)));
+typedef s32 mcts_score_s32_t __attribute__((vector_size(MCTS_SCORE_BYTES)));
+typedef u32 mcts_score_u32_t __attribute__((vector_size(MCTS_SCORE_BYTES)));
+typedef u8 mcts_score_u8_t __attribute__((vector_size(MCTS_SCORE_BYTES / sizeof(f32))));
+
+#define MCTS_SCORE_LANES (MCTS_SCORE_BYTES / sizeof(f32))
+
+_Static_assert(MCTS_BLOCK_MIN_CAP % MCTS_SCORE_LANES == 0, "Child blocks must hold whole score vectors");
+
+static inline mcts_score_t
+mcts_score_sqrt(mcts_score_t val)
+{
+#if defined(__AVX__)
+	return (mcts_score_t) _mm256_sqrt_ps((__m256) val);
+#elif defined(__SSE__)
+	return (mcts_score_t) _mm_sqrt_ps((__m128) val);
+#else
+	for (size_t i = 0; i < MCTS_SCORE_LANES; i++)
+		val[i] = sqrtf(val[i]);
+
+	return val;
+#endif
+}
+
+static inline mcts_score_t
+mcts_score_select(mcts_score_mask_t mask, mcts_score_t lhs, mcts_score_t rhs)
+{
+	return (mcts_score_t) ((mask & (mcts_score_mask_t) lhs) | (~mask & (mcts_score_mask_t) rhs));
+}
+
+static struct mcts_node *
+mcts_node_best_child(struct mcts_node *self, struct agent_mcts *agent)
+{
+	assert(self);
+	assert(agent);
+
+	/* MCTS-RAVE formula:
+	 * ((1 - beta(n, n')) * (w / n)) + (beta(n, n') * (w' / n')) + (c * sqrt(ln t / n))
+	 * ---
+	 *  n = number of won playouts for this node
+	 *  n' = number of won playouts for this node for a given move
+	 *  w = total number of playouts for this node
+	 *  w' = total number of playouts for this node for a given move
+	 *  c = exploration parameter (sqrt(2), or found experimentally)
+	 *  t = total number of playouts for parent node
+	 *  beta(n, n') = function close to 1 for small n, and close to 0 for large n
+	 *
+	 * every child is scored in a single pass over the contiguous children
+	 * arrays, with children that have not yet been played given the default
+	 * maximum value so that they are picked first, and children proven to
+	 * lose never picked at all (a node with a proven win among its children
+	 * is itself proven, and so never selected). once every child is proven
+	 * to lose, they are all scored as usual, so that the search keeps
+	 * looking for the most stubborn one
+	 */
+	if (!self->children_len) return NULL;
+
+	struct mcts_block *block = mcts_deref(agent->pool.ptr, self->block);
+	struct mcts_children children = mcts_block_children(block);
+
+	f32 log_parent_plays = logf(self->plays);
+
+	mcts_score_t const zero = {0}, one = zero + 1.0f;
+	mcts_score_t const rounds = zero + MCTS_EXPLORATION_ROUNDS;
+	mcts_score_t const infinity = zero + INFINITY, neg_infinity = zero - INFINITY;
+
+	/* no child is ever proven -1, so that comparing against it masks none */
+	mcts_score_s32_t const lost = (mcts_score_s32_t) {0} + (self->proof == MCTS_PROOF_WIN ? -1 : MCTS_PROOF_LOSS);
+
+	mcts_score_t best_score = neg_infinity;
+	mcts_score_s32_t best_index = {0}, index = {0};
+	for (size_t i = 0; i < MCTS_SCORE_LANES; i++) index[i] = i;
+
+	for (size_t i = 0; i < self->children_len; i += MCTS_SCORE_LANES, index += (s32) MCTS_SCORE_LANES) {
+		mcts_score_s32_t wins_s32, rave_wins_s32;
+		mcts_score_u32_t plays_u32, rave_plays_u32;
+
+		memcpy(&wins_s32, &children.wins[i], sizeof wins_s32);
+		memcpy(&plays_u32, &children.plays[i], sizeof plays_u32);
+		memcpy(&rave_wins_s32, &children.rave_wins[i], sizeof rave_wins_s32);
+		memcpy(&rave_plays_u32, &children.rave_plays[i], sizeof rave_plays_u32);
+
+		mcts_score_u8_t proofs_u8;
+		memcpy(&proofs_u8, &children.proofs[i], sizeof proofs_u8);
+		mcts_score_s32_t proofs = __builtin_convertvector(proofs_u8, mcts_score_s32_t);
+
+		mcts_score_t wins = __builtin_convertvector(wins_s32, mcts_score_t);
+		mcts_score_t plays = __builtin_convertvector(plays_u32, mcts_score_t);
+		mcts_score_t rave_wins = __builtin_convertvector(rave_wins_s32, mcts_score_t);
+		mcts_score_t rave_plays = __builtin_convertvector(rave_plays_u32, mcts_score_t);
+
+		mcts_score_t beta = (rounds - plays) / rounds;
+		beta = mcts_score_select(beta > zero, beta, zero);
+
+		mcts_score_t exploration = (f32) MCTS_EXPLORATION_PARAM * mcts_score_sqrt(log_parent_plays / plays);
+		mcts_score_t exploitation = (one - beta) * (wins / plays);
+		mcts_score_t rave_exploitation = mcts_score_select(rave_plays > zero, beta * (rave_wins / rave_plays), zero);
+
+		mcts_score_t score = exploration + exploitation + rave_exploitation;
+		score = mcts_score_select(plays > zero, score, infinity);
+		score = mcts_score_select(proofs != lost, score, neg_infinity);
+		score = mcts_score_select(index < (s32) self->children_len, score, neg_infinity);
+
+		mcts_score_mask_t better = score > best_score;
+		best_score = mcts_score_select(better, score, best_score);
+		best_index = (better & index) | (~better & best_index);
+	}
+
+	f32 max_score = -INFINITY;
+	size_t best = 0;
+	for (size_t i = 0; i < MCTS_SCORE_LANES; i++) {
+		if (best_score[i] > max_score || (best_score[i] == max_score && (size_t) best_index[i] < best)) {
+			max_score = best_score[i];
+			best = best_index[i];
+		}
+	}
+
+	return mcts_deref(agent->pool.ptr, children.nodes[best]);
+}
+
+static void
+mcts_pool_reset(struct agent_mcts *self)
+{
+	assert(self);
+
+	mem_pool_reset(&self->pool);
+
+	self->free_nodes = MCTS_REF_NULL;
+	for (size_t i = 0; i < MCTS_BLOCK_CLASSES; i++)
+		self->free_blocks[i] = MCTS_REF_NULL;
+}
+
+static struct mcts_node *
+mcts_root_alloc(struct agent_mcts *self, enum hex_player player, u8 x, u8 y)
+{
+	assert(self);
+
+	struct mcts_node *root = mem_pool_alloc(&self->pool, MCTS_POOL_ALIGN, sizeof *root);
+	assert(root);
+
+	size_t moves = board_available_moves(self->board, NULL);
+	mcts_node_init(root, NULL, self->pool.ptr, player, x, y, moves);
+
+	return root;
+}
+
+static inline bool
+mcts_move_allowed(struct agent_mcts const *self, struct mcts_node const *node, u16 cell)
+{
+	if (node != self->root) return true;
+
+	if (self->root_pruned && !(self->root_allowed & hsearch_bit(cell))) return false;
+
+	return !self->root_dominance
+	    || !(self->board->inferior[cell] & INFERIOR_DOMINATED(hexopponent(node->player)));
+}
+
+/* releases the children of the root that are no longer allowed (e.g. those
+ * searched while pondering), and counts the moves left to it
+ */
+static void
+mcts_root_restrict(struct agent_mcts *self)
+{
+	assert(self);
+
+	struct mcts_node *root = self->root;
+
+	for (size_t i = 0; i < root->children_len; /* nop */) {
+		struct mcts_block *block = mcts_deref(self->pool.ptr, root->block);
+		struct mcts_children children = mcts_block_children(block);
+
+		if (mcts_move_allowed(self, root, children.cells[i])) {
+			i++;
+			continue;
+		}
+
+		struct mcts_node *child = mcts_deref(self->pool.ptr, children.nodes[i]);
+
+		mcts_node_remove_child(root, self, i);
+		mcts_node_release_subtree(child, self);
+	}
+
+	u16 moves = 0;
+	for (size_t i = 0; i < self->root_cells_len; i++) {
+		if (mcts_move_allowed(self, root, self->root_cells[i])) moves++;
+	}
+
+	root->moves = moves;
+}
+
+static void
+mcts_root_load(struct agent_mcts *self)
+{
+	assert(self);
+
+	bitboard_load(&self->root_board, self->board);
+
+	/* neither leaving out dead cells nor filling in captured ones changes
+	 * the value of the position, and both shorten every playout
+	 */
+	bool filled[BITBOARD_MAX_SIZE * BITBOARD_MAX_SIZE] = {0};
+	bool dissolved = false, fresh = false;
+
+	self->root_cells_len = 0;
+	for (size_t i = 0; i < self->board->empty_len; i++) {
+		u16 cell = self->board->empty[i];
+		u8 inferior = self->board->inferior[cell];
+
+		if (!(inferior & INFERIOR_FILLIN)) {
+			dissolved |= self->root_filled[cell];
+			self->root_cells[self->root_cells_len++] = cell;
+			continue;
+		}
+
+		for (enum hex_player player = HEX_PLAYER_BLACK; player <= HEX_PLAYER_WHITE; player++) {
+			if (inferior & INFERIOR_CAPTURED(player))
+				bitboard_play(&self->root_board, player, cell % self->geometry.size, cell / self->geometry.size);
+		}
+
+		fresh |= !self->root_filled[cell];
+		filled[cell] = true;
+	}
+
+	memcpy(self->root_filled, filled, sizeof filled);
+
+	/* the tree only ever played on the cells it saw empty, so a cell
+	 * filled in since merely takes the subtrees below it. a cell no longer
+	 * filled in, on the other hand, was played by its capturer in every
+	 * round the tree saw, and so leaves none of its statistics usable
+	 */
+	if (dissolved && self->root->children_len) {
+		struct mcts_node *root = self->root;
+
+		dbglog(LOG_INFO, "Captured cells no longer captured, resetting MCTS tree with %" PRIu32 " plays\n",
+				 root->plays);
+
+		mcts_pool_reset(self);
+		self->root = mcts_root_alloc(self, root->player, root->x, root->y);
+	} else if (fresh) {
+		mcts_node_release_filled(self->root, self, filled);
+	}
+
+	/* dominated moves are only left out while some other move remains */
+	self->root_dominance = true;
+	mcts_root_restrict(self);
+
+	if (!self->root->moves) {
+		self->root_dominance = false;
+		mcts_root_restrict(self);
+	}
+
+	dbglog(LOG_DEBUG, "Loaded MCTS root with %" PRIu16 " moves of %" PRIu32 " empty cells\n",
+			  self->root->moves, self->board->empty_len);
+}
+
+static bool
+mcts_thread_create(pthread_t *thread, void *(*routine)(void *), void *arg)
+{
+	/* a small, fixed stack keeps our helper threads within the memory we
+	 * reserved for them
+	 */
+	pthread_attr_t attr;
+	if (pthread_attr_init(&attr)) return false;
+
+	pthread_attr_setstacksize(&attr, MCTS_THREAD_STACK);
+
+	bool created = pthread_create(thread, &attr, routine, arg) == 0;
+
+	pthread_attr_destroy(&attr);
+
+	return created;
+}
+
+static void *
+mcts_prefault(void *arg)
+{
+	struct agent_mcts *self = arg;
+
+	/* populating the pool does not modify its contents, so this is safe to
+	 * run alongside a search that already allocates from the pool
+	 */
+	u64 start = timeman_now();
+
+	size_t offset = 0;
+	while (offset < self->pool.mapped && !atomic_load_explicit(&self->prefault_stop, memory_order_relaxed)) {
+		if (!mem_pool_populate(&self->pool, offset, MCTS_PREFAULT_CHUNK)) {
+			dbglog(LOG_WARN, "Failed to prefault MCTS node pool: %s\n", strerror(errno));
+			return NULL;
+		}
+
+		offset += MCTS_PREFAULT_CHUNK;
+	}
+
+	dbglog(LOG_INFO, "Prefaulted %zu bytes of MCTS node pool in %.3f seconds\n",
+			 offset < self->pool.mapped ? offset : self->pool.mapped,
+			 (double) (timeman_now() - start) / NANOSECS);
+
+	return NULL;
+}
+
+bool
+agent_mcts_init(struct agent_mcts *self, struct board const *board, struct threadpool *threadpool,
+		u32 mem_limit_mib, enum hex_player player)
+{
+	assert(self);
+
+	self->board = board;
+	self->threadpool = threadpool;
+	self->player = player;
+	self->pondering = false;
+	self->ponder_unavailable = false;
+
+	if (!bitboard_geometry_init(&self->geometry, board->size)) {
+		dbglog(LOG_ERROR, "Board size %" PRIu32 " exceeds maximum supported bitboard size %d\n",
+				  board->size, BITBOARD_MAX_SIZE);
+		return false;
+	}
+
+	bitboard_init(&self->root_board, &self->geometry);
+	bitboard_init(&self->shadow_board, &self->geometry);
+
+	self->playout = playout_batch_kernel(board->size, (enum playout_policy) opts.playout_policy);
+
+	self->root_pruned = false;
+	memset(self->root_filled, 0, sizeof self->root_filled);
+
+	self->hsearch_enabled = hsearch_supported(board->size);
+	self->hsearch_pending_valid = false;
+	if (self->hsearch_enabled) {
+		if (!hsearch_init(&self->hsearch[HEX_PLAYER_BLACK], board->size, HEX_PLAYER_BLACK))
+			return false;
+
+		if (!hsearch_init(&self->hsearch[HEX_PLAYER_WHITE], board->size, HEX_PLAYER_WHITE)) {
+			hsearch_free(&self->hsearch[HEX_PLAYER_BLACK]);
+			return false;
+		}
+
+		hsearch_load(&self->hsearch[HEX_PLAYER_BLACK], board);
+		hsearch_load(&self->hsearch[HEX_PLAYER_WHITE], board);
+	}
+
+	/* the server advertises its limit, but what counts is the limit we
+	 * actually run under, less what the process already uses
+	 */
+	size_t available = memory_available(mem_limit_mib * MiB);
+	size_t reserved = RESERVED_MEM + MCTS_HELPER_THREADS * MCTS_THREAD_STACK;
+
+	if (available <= reserved) {
+		dbglog(LOG_ERROR, "Only %zu bytes of memory available, below the %zu bytes reserved\n",
+				  available, reserved);
+		goto error_hsearch;
+	}
+
+	dbglog(LOG_INFO, "MCTS memory budget: %zu of %zu advertised bytes available, %zu reserved\n",
+			 available, (size_t) (mem_limit_mib * MiB), reserved);
+
+	size_t align = MCTS_POOL_ALIGN;
+	size_t budget = available - reserved;
+	size_t ttable_cap = budget / MCTS_TTABLE_FRACTION;
+	size_t dfpn_cap = budget / MCTS_DFPN_FRACTION;
+
+	if (!ttable_init(&self->ttable, ttable_cap)) goto error_hsearch;
+
+	self->dfpn_failed_empty = SIZE_MAX;
+
+	if (!dfpn_init(&self->dfpn, board->size, dfpn_cap)) {
+		dbglog(LOG_ERROR, "Failed to initialise endgame solver with %zu bytes\n", dfpn_cap);
+		goto error_ttable;
+	}
+
+	/* whatever the table's rounding leaves over goes to the node pool */
+	size_t cap = (budget - ttable_size(&self->ttable) - dfpn_cap) & ~(align - 1);
+
+	if (!mem_pool_init(&self->pool, align, cap)) goto error_dfpn;
+
+	mcts_pool_reset(self);
+
+	self->reclaimed_nodes = self->reclaimed_bytes = 0;
+
+	self->root = mcts_root_alloc(self, hexopponent(player), 0, 0);
+
+	self->prefaulting = false;
+	if (opts.prefault) {
+		atomic_store(&self->prefault_stop, false);
+
+		if (!mcts_thread_create(&self->prefault_thread, mcts_prefault, self)) {
+			dbglog(LOG_WARN, "Failed to start prefaulting thread\n");
+		} else {
+			self->prefaulting = true;
+		}
+	}
+
+	return true;
+
+error_dfpn:
+	dfpn_free(&self->dfpn);
+error_ttable:
+	ttable_free(&self->ttable);
+error_hsearch:
+	if (self->hsearch_enabled) {
+		hsearch_free(&self->hsearch[HEX_PLAYER_BLACK]);
+		hsearch_free(&self->hsearch[HEX_PLAYER_WHITE]);
+	}
+
+	return false;
+}
+
+void
+agent_mcts_free(struct agent_mcts *self)
+{
+	assert(self);
+
+	agent_mcts_ponder_stop(self);
+
+	if (self->prefaulting) {
+		atomic_store(&self->prefault_stop, true);
+		pthread_join(self->prefault_thread, NULL);
+	}
+
+	mem_pool_free(&self->pool);
+	dfpn_free(&self->dfpn);
+	ttable_free(&self->ttable);
+
+	if (self->hsearch_enabled) {
+		hsearch_free(&self->hsearch[HEX_PLAYER_BLACK]);
+		hsearch_free(&self->hsearch[HEX_PLAYER_WHITE]);
+	}
+}
+
+/* plays a pending opponent move into both engines, giving each engine up
+ * to half of the slice (or no deadline, for a slice of UINT64_MAX)
+ */
+static void
+mcts_hsearch_flush(struct agent_mcts *self, u64 slice)
+{
+	assert(self);
+
+	if (!self->hsearch_pending_valid) return;
+
+	enum hex_player player = hexopponent(self->player);
+	u32 x = self->hsearch_pending.x, y = self->hsearch_pending.y;
+
+	hsearch_play(&self->hsearch[HEX_PLAYER_BLACK], player, x, y,
+		     slice == UINT64_MAX ? UINT64_MAX : timeman_now() + slice / 2);
+	hsearch_play(&self->hsearch[HEX_PLAYER_WHITE], player, x, y,
+		     slice == UINT64_MAX ? UINT64_MAX : timeman_now() + slice / 2);
+
+	self->hsearch_pending_valid = false;
+}
+
+void
+agent_mcts_play(struct agent_mcts *self, enum hex_player player, u32 x, u32 y)
+{
+	assert(self);
+	assert(!self->pondering);
+
+	/* our own move is played once it has been sent, so its update runs on
+	 * the opponent's time, while the opponent's move waits for our budget
+	 */
+	if (self->hsearch_enabled) {
+		mcts_hsearch_flush(self, UINT64_MAX);
+
+		if (player == self->player) {
+			hsearch_play(&self->hsearch[HEX_PLAYER_BLACK], player, x, y, UINT64_MAX);
+			hsearch_play(&self->hsearch[HEX_PLAYER_WHITE], player, x, y, UINT64_MAX);
+		} else {
+			self->hsearch_pending = (struct move) { .x = x, .y = y, };
+			self->hsearch_pending_valid = true;
+		}
+	}
+
+	/* the restriction only ever applies to the position it was made for */
+	self->root_pruned = false;
+
+	/* if the move was searched, the subtree below it stays valid for the
+	 * new position and keeps its statistics, and everything else is
+	 * released for reuse
+	 */
+	struct mcts_node *old_root = self->root;
+	struct mcts_node *child = mcts_node_get_child(old_root, self, y * self->geometry.size + x);
+
+	if (child) {
+		assert(child->player == player);
+
+		struct mcts_block *block = mcts_deref(self->pool.ptr, old_root->block);
+		for (size_t i = 0; i < old_root->children_len; i++) {
+			struct mcts_node *sibling = mcts_deref(self->pool.ptr, block->nodes[i]);
+			if (sibling != child) mcts_node_release_subtree(sibling, self);
+		}
+
+		mcts_node_release(old_root, self);
+
+		child->parent = MCTS_REF_NULL;
+		child->index = 0;
+
+		self->root = child;
+
+		dbglog(LOG_INFO, "Reusing MCTS subtree with %" PRIu32 " plays for move (%" PRIu32 ", %" PRIu32 ")\n",
+				 child->plays, x, y);
+
+		return;
+	}
+
+	mcts_pool_reset(self);
+
+	self->root = mcts_root_alloc(self, player, x, y);
+
+	// TODO: implement tree compaction
+	//       one possible issue is the fact that walking the tree to
+	//       compact it takes a significant amount of time and potentially
+	//       outweighs simply resetting the pool and performing a few more
+	//       rounds of MCTS.
+	//
+	//       another option would be to implement some form of cyclic
+	//       memory pool, to allow allocations from memory behind the
+	//       current root node, as well as in front of it, but this would
+	//       require tracking stale leaf nodes and reclaiming them (hence
+	//       transforms into a GC, and thus wastes the benefits of a
+	//       simple memory pool)
+}
+
+void
+agent_mcts_swap(struct agent_mcts *self)
+{
+	assert(self);
+	assert(!self->pondering);
+
+	struct mcts_node old_root = *self->root;
+
+	if (self->hsearch_enabled) {
+		hsearch_load(&self->hsearch[HEX_PLAYER_BLACK], self->board);
+		hsearch_load(&self->hsearch[HEX_PLAYER_WHITE], self->board);
+		self->hsearch_pending_valid = false;
+	}
+
+	self->root_pruned = false;
+	memset(self->root_filled, 0, sizeof self->root_filled);
+
+	self->dfpn_failed_empty = SIZE_MAX;
+
+	mcts_pool_reset(self);
+
+	self->root = mcts_root_alloc(self, hexopponent(old_root.player), old_root.x, old_root.y);
+}
+
+static bool
+mcts_search(struct agent_mcts *self, struct timeman_budget const *budget);
+
+static void
+mcts_root_prune(struct agent_mcts *self, hsearch_set_t allowed)
+{
+	assert(self);
+	assert(!self->root_pruned);
+
+	self->root_allowed = allowed;
+	self->root_pruned = true;
+
+	mcts_root_load(self);
+}
+
+/* consults the virtual connections of both players before searching, once
+ * the opponent's last move has been played into them (within a slice of
+ * the budget): a semi connection between our edges is a won game, and
+ * every opponent connection between their edges has to be broken by our
+ * move
+ */
+static bool
+mcts_hsearch_move(struct agent_mcts *self, struct timeman_budget *budget, u32 *out_x, u32 *out_y)
+{
+	assert(self);
+	assert(budget);
+	assert(out_x);
+	assert(out_y);
+
+	if (!self->hsearch_enabled) return false;
+
+	if (self->hsearch_pending_valid) {
+		u64 start = timeman_now();
+		mcts_hsearch_flush(self, budget->soft / MCTS_HSEARCH_TIME_FRACTION);
+		u64 elapsed = timeman_now() - start;
+
+		budget->soft = budget->soft > elapsed + TIMEMAN_MIN_NANOS ? budget->soft - elapsed : TIMEMAN_MIN_NANOS;
+		budget->hard = budget->hard > elapsed + TIMEMAN_MIN_NANOS ? budget->hard - elapsed : TIMEMAN_MIN_NANOS;
+	}
+
+	struct hsearch *own = &self->hsearch[self->player];
+	struct hsearch *other = &self->hsearch[hexopponent(self->player)];
+
+	u32 cell;
+	if (hsearch_winning_move(own, &cell)) {
+		dbglog(LOG_INFO, "Virtual connection wins the game, playing its key (%" PRIu32 ", %" PRIu32 ")\n",
+				 cell % self->geometry.size, cell / self->geometry.size);
+
+		*out_x = cell % self->geometry.size;
+		*out_y = cell / self->geometry.size;
+
+		return true;
+	}
+
+	/* with the opponent already connected every move loses, so we leave
+	 * the search free to find the most stubborn one
+	 */
+	hsearch_set_t mustplay;
+	if (!self->root_pruned && hsearch_mustplay(other, &mustplay) && mustplay) {
+		mcts_root_prune(self, mustplay);
+
+		dbglog(LOG_INFO, "Opponent threatens a virtual connection, restricting search to %" PRIu16 " moves\n",
+				 self->root->moves);
+	}
+
+	return false;
+}
+
+/* tries to solve small enough positions outright, within a fraction of the
+ * budget, which is shrunk by the time spent. a proven loss still leaves the
+ * search to find the most stubborn move
+ */
+static bool
+mcts_dfpn_move(struct agent_mcts *self, struct timeman_budget *budget, u32 *out_x, u32 *out_y)
+{
+	assert(self);
+	assert(budget);
+	assert(out_x);
+	assert(out_y);
+
+	/* benchmarks measure the search alone */
+	if (budget->rounds) return false;
+
+	size_t empty = board_available_moves(self->board, NULL);
+	if (empty > MCTS_DFPN_MAX_EMPTY) return false;
+
+	if (self->dfpn_failed_empty != SIZE_MAX && empty + MCTS_DFPN_RETRY_EMPTY > self->dfpn_failed_empty)
+		return false;
+
+	u64 start = timeman_now();
+	u64 slice = budget->soft / MCTS_DFPN_TIME_FRACTION;
+
+	enum dfpn_result res = dfpn_solve(&self->dfpn, self->board, self->player,
+					  start + slice, MCTS_DFPN_MAX_NODES, out_x, out_y);
+
+	u64 elapsed = timeman_now() - start;
+
+	dbglog(LOG_INFO, "Endgame solver %s position with %zu empty cells in %.3f seconds (%zu nodes)\n",
+			 res == DFPN_WIN ? "won" : res == DFPN_LOSS ? "lost" : "did not solve",
+			 empty, (double) elapsed / NANOSECS, self->dfpn.nodes);
+
+	if (res == DFPN_WIN) return true;
 
-	self->wins = self->rave_wins = 0;
-	self->plays = self->rave_plays = 0;
+	self->dfpn_failed_empty = empty;
 
-	self->children_cap = children;
-	self->children_len = 0;
+	budget->soft = budget->soft > elapsed + TIMEMAN_MIN_NANOS ? budget->soft - elapsed : TIMEMAN_MIN_NANOS;
+	budget->hard = budget->hard > elapsed + TIMEMAN_MIN_NANOS ? budget->hard - elapsed : TIMEMAN_MIN_NANOS;
+
+	return false;
 }
 
+/* picks a move without the tree, should the search not have expanded a
+ * single one (e.g. when the root board is already decided once captured
+ * cells are filled in). a cell that would connect the opponent's edges has
+ * to be taken, and otherwise a move allowed at the root (which stops any
+ * virtual connection of the opponent) is better than any other
+ */
 static bool
-mcts_node_expand(struct mcts_node *self, struct mem_pool *pool, u8 x, u8 y)
+mcts_fallback_move(struct agent_mcts *self, u32 *out_x, u32 *out_y)
 {
 	assert(self);
-	assert(pool);
+	assert(out_x);
+	assert(out_y);
 
-	struct mcts_node *child = mem_pool_alloc(pool, alignof(struct mcts_node),
-						 mcts_node_sizeof(self->children_cap - 1));
+	u32 size = self->geometry.size;
 
-	if (!child) {
-		dbglog(LOG_WARN, "Failed to allocate child node. Consider compacting memory pool\n");
-		return false;
+	/* finding connections compresses paths, so the solver's board is used
+	 * as scratch rather than the game board
+	 */
+	struct board *scratch = &self->dfpn.board;
+	board_copy(self->board, scratch);
+
+	enum hex_player opponent = hexopponent(self->player);
+	for (size_t i = 0; i < scratch->empty_len; i++) {
+		u16 cell = scratch->empty[i];
+		if (!board_completes(scratch, opponent, cell % size, cell / size)) continue;
+
+		*out_x = cell % size;
+		*out_y = cell / size;
+
+		return true;
+	}
+
+	for (size_t i = 0; i < self->root_cells_len; i++) {
+		u16 cell = self->root_cells[i];
+		if (!mcts_move_allowed(self, self->root, cell)) continue;
+
+		*out_x = cell % size;
+		*out_y = cell / size;
+
+		return true;
+	}
+
+	/* the cells stopping an opponent connection may all be filled in */
+	for (size_t i = 0; i < scratch->empty_len; i++) {
+		u16 cell = scratch->empty[i];
+		if (self->root_pruned && !(self->root_allowed & hsearch_bit(cell))) continue;
+
+		*out_x = cell % size;
+		*out_y = cell / size;
+
+		return true;
 	}
 
-	mcts_node_init(child, self, hexopponent(self->player), x, y, self->children_cap - 1);
+	if (!scratch->empty_len) return false;
 
-	self->children[self->children_len++] = mcts_node_abs2rel(self, child);
+	*out_x = scratch->empty[0] % size;
+	*out_y = scratch->empty[0] / size;
 
 	return true;
 }
 
-static struct mcts_node *
-mcts_node_get_child(struct mcts_node *self, u8 x, u8 y)
+bool
+agent_mcts_next(struct agent_mcts *self, struct timeman_budget const *budget, u32 *out_x, u32 *out_y)
 {
 	assert(self);
+	assert(budget);
+	assert(out_x);
+	assert(out_y);
 
-	if (!self->children_len) return NULL;
+	struct timeman_budget remaining = *budget;
+	if (mcts_hsearch_move(self, &remaining, out_x, out_y)) return true;
+	if (mcts_dfpn_move(self, &remaining, out_x, out_y)) return true;
 
-	for (size_t i = 0; i < self->children_cap; i++) {
-		struct mcts_node *child = mcts_node_rel2abs(self, self->children[i]);
-		if (!child) continue;
+	if (!mcts_search(self, &remaining)) return false;
 
-		if (child->x == x && child->y == y) return child;
-	}
+	struct mcts_node *root = self->root;
 
-	return NULL;
-}
+	if (!root->children_len) {
+		dbglog(LOG_WARN, "MCTS search expanded no moves, falling back to an unsearched move\n");
 
-static f32
-mcts_node_calc_score(struct mcts_node *self)
-{
-	assert(self);
+		return mcts_fallback_move(self, out_x, out_y);
+	}
 
-	/* MCTS-RAVE formula:
-	 * ((1 - beta(n, n')) * (w / n)) + (beta(n, n') * (w' / n')) + (c * sqrt(ln t / n))
-	 * ---
-	 *  n = number of won playouts for this node
-	 *  n' = number of won playouts for this node for a given move
-	 *  w = total number of playouts for this node
-	 *  w' = total number of playouts for this node for a given move
-	 *  c = exploration parameter (sqrt(2), or found experimentally)
-	 *  t = total number of playouts for parent node
-	 *  beta(n, n') = function close to 1 for small n, and close to 0 for large n
-	 */
+	struct mcts_block *block = mcts_deref(self->pool.ptr, root->block);
+	struct mcts_children children = mcts_block_children(block);
 
-	/* if this node has not yet been played, return the default maximum value
-	 * so that it is picked during expansion
+	/* a proven win is played regardless of its plays, and proven losses
+	 * only when every move loses (in which case the most searched one is
+	 * the most stubborn)
 	 */
-	if (!self->plays) return INFINITY;
+	u32 max_plays = 0;
+	size_t best = root->children_len;
+	for (size_t i = 0; i < root->children_len; i++) {
+		if (children.proofs[i] == MCTS_PROOF_WIN) {
+			best = i;
+			break;
+		}
 
-	s64 exploration_rounds = 3000;
-	f32 beta = MAX(0.0, (exploration_rounds - self->plays) / (f32) exploration_rounds);
-	assert(0.0 <= beta && beta <= 1.0);
+		if (children.proofs[i] == MCTS_PROOF_LOSS && root->proof != MCTS_PROOF_WIN) continue;
 
-	dbglog(LOG_DEBUG, "beta: %lf, wins: %d, rave_wins: %d, plays: %u, rave_plays: %u\n",
-			  beta, self->wins, self->rave_wins, self->plays, self->rave_plays);
+		if (best == root->children_len || children.plays[i] > max_plays) {
+			max_plays = children.plays[i];
+			best = i;
+		} else if (children.plays[i] == max_plays && rng_bounded(2)) {
+			best = i;
+		}
+	}
 
-	struct mcts_node *parent = mcts_node_rel2abs(self, self->parent);
-	assert(parent);
+	/* with every expanded move lost, a move not yet expanded may not be */
+	if (best == root->children_len) {
+		for (size_t i = 0; i < self->root_cells_len; i++) {
+			u16 cell = self->root_cells[i];
+			if (!mcts_move_allowed(self, root, cell) || mcts_node_get_child(root, self, cell)) continue;
 
-	f32 exploration = M_SQRT2 * sqrtf(logf(parent->plays) / (f32) self->plays);
+			*out_x = cell % self->geometry.size;
+			*out_y = cell / self->geometry.size;
 
-	f32 exploitation = (1 - beta) * ((f32) self->wins / (f32) self->plays);
-	assert(-1.0 <= exploitation && exploitation <= 1.0);
+			return true;
+		}
 
-	f32 rave_exploitation = beta * ((f32) self->rave_wins / (f32) self->rave_plays);
-	assert(-1.0 <= rave_exploitation && rave_exploitation <= 1.0);
+		best = 0;
+	}
 
-	dbglog(LOG_DEBUG, "exploration: %f, exploitation: %f, rave_exploitation: %f\n",
-			exploration, exploitation, rave_exploitation);
+	*out_x = children.cells[best] % self->geometry.size;
+	*out_y = children.cells[best] / self->geometry.size;
 
-	return exploration + exploitation + rave_exploitation;
+	return true;
 }
 
-static struct mcts_node *
-mcts_node_best_child(struct mcts_node *self)
+static size_t
+mcts_reclaim(struct agent_mcts *self)
 {
 	assert(self);
 
-	f32 max_score = -INFINITY;
-	struct mcts_node *best_child = NULL;
-	for (size_t i = 0; i < self->children_cap; i++) {
-		struct mcts_node *child = mcts_node_rel2abs(self, self->children[i]);
-		if (!child) continue;
-
-		dbglog(LOG_DEBUG, "Node: {parent=%p, children=%" PRIu8 ", x=%" PRIu32 ", y=%" PRIu32 "}\n",
-				mcts_node_rel2abs(child, child->parent), child->children_len, child->x, child->y);
+	size_t start = self->reclaimed_bytes;
+	size_t target = self->pool.cap / MCTS_RECLAIM_FRACTION;
 
-		f32 score = mcts_node_calc_score(child);
+	/* we release every subtree with at most threshold plays, raising the
+	 * threshold until enough memory has been reclaimed. the root's direct
+	 * children are never released, as they hold the statistics for the
+	 * move that is about to be made
+	 */
+	while (self->reclaim_threshold <= self->root->plays) {
+		struct mcts_block *block = mcts_deref(self->pool.ptr, self->root->block);
 
-		if (score > max_score) {
-			max_score = score;
-			best_child = child;
+		for (size_t i = 0; i < self->root->children_len; i++) {
+			struct mcts_node *child = mcts_deref(self->pool.ptr, block->nodes[i]);
+			mcts_node_reclaim(child, self, self->reclaim_threshold);
 		}
+
+		if (self->reclaimed_bytes - start >= target) break;
+
+		self->reclaim_threshold *= 2;
 	}
 
-	return best_child;
+	dbglog(LOG_DEBUG, "Reclaimed %zu bytes with visit threshold %" PRIu32 "\n",
+			  self->reclaimed_bytes - start, self->reclaim_threshold);
+
+	return self->reclaimed_bytes - start;
 }
 
-bool
-agent_mcts_init(struct agent_mcts *self, struct board const *board, struct threadpool *threadpool,
-		u32 mem_limit_mib, enum hex_player player)
+static void
+mcts_rave_prepare(struct agent_mcts *self, struct playout_batch const *batch)
 {
 	assert(self);
+	assert(batch);
 
-	self->board = board;
-	self->threadpool = threadpool;
-
-	if (!board_init(&self->shadow_board, board->size)) return false;
+	/* a move on a cell counts as played (for amaf) in every lane where its
+	 * player ended up owning that cell, and as won in those lanes where
+	 * that player also won. statistics are relative to the player making
+	 * the move, so a loss counts against the move
+	 */
+	for (size_t p = 0; p < 2; p++) {
+		playout_mask_t won = playout_batch_wins(batch, hexopponent(p));
+		playout_mask_t const *owners = batch->owned[p];
 
-	size_t align = alignof(struct mcts_node);
-	size_t cap = ((mem_limit_mib * MiB) - RESERVED_MEM) & ~(align - 1);
+		for (size_t i = 0; i < self->geometry.cells; i++) {
+			s32 owned = __builtin_popcount(owners[i]);
 
-	if (!mem_pool_init(&self->pool, align, cap)) {
-		board_free(&self->shadow_board);
-		return false;
+			self->rave_plays_delta[p][i] = owned;
+			self->rave_wins_delta[p][i] = owned - 2 * __builtin_popcount(owners[i] & won);
+		}
 	}
-
-	size_t moves = board_available_moves(board, NULL);
-	self->root = mem_pool_alloc(&self->pool, alignof(struct mcts_node), mcts_node_sizeof(moves));
-	mcts_node_init(self->root, NULL, hexopponent(player), 0, 0, moves);
-
-	return true;
 }
 
-void
-agent_mcts_free(struct agent_mcts *self)
+static void
+mcts_node_update_rave(struct mcts_node *self, struct agent_mcts *agent)
 {
 	assert(self);
+	assert(agent);
 
-	mem_pool_free(&self->pool);
-}
+	if (!self->children_len) return;
 
-void
-agent_mcts_play(struct agent_mcts *self, enum hex_player player, u32 x, u32 y)
-{
-	assert(self);
+	struct mcts_children children = mcts_block_children(mcts_deref(agent->pool.ptr, self->block));
 
-	mem_pool_reset(&self->pool);
+	/* every child of a node is played by the same player, so its amaf
+	 * statistics come from that player's deltas, gathered by the cell of
+	 * every child and added a whole vector at a time. blocks hold whole
+	 * vectors, and lanes past the last child add nothing
+	 */
+	enum hex_player player = hexopponent(self->player);
+	s32 const *plays_delta = agent->rave_plays_delta[player];
+	s32 const *wins_delta = agent->rave_wins_delta[player];
+
+	size_t len = self->children_len;
+	for (size_t i = 0; i < len; i += MCTS_SCORE_LANES) {
+		mcts_score_s32_t plays = {0}, wins = {0};
+		for (size_t l = 0; l < MCTS_SCORE_LANES && i + l < len; l++) {
+			u16 cell = children.cells[i + l];
+
+			plays[l] = plays_delta[cell];
+			wins[l] = wins_delta[cell];
+		}
 
-	size_t moves = board_available_moves(self->board, NULL);
-	self->root = mem_pool_alloc(&self->pool, alignof(struct mcts_node), mcts_node_sizeof(moves));
-	mcts_node_init(self->root, NULL, player, x, y, moves);
+		mcts_score_u32_t rave_plays;
+		mcts_score_s32_t rave_wins;
 
-	// TODO: implement tree reuse, if it improves play
-	//
-	//       one possible issue is children containing stale board states,
-	//       leading to potentially invalid moves being generated.
+		memcpy(&rave_plays, &children.rave_plays[i], sizeof rave_plays);
+		memcpy(&rave_wins, &children.rave_wins[i], sizeof rave_wins);
 
-	// TODO: implement tree compaction
-	//       one possible issue is the fact that walking the tree to
-	//       compact it takes a significant amount of time and potentially
-	//       outweighs simply resetting the pool and performing a few more
-	//       rounds of MCTS.
-	//
-	//       another option would be to implement some form of cyclic
-	//       memory pool, to allow allocations from memory behind the
-	//       current root node, as well as in front of it, but this would
-	//       require tracking stale leaf nodes and reclaiming them (hence
-	//       transforms into a GC, and thus wastes the benefits of a
-	//       simple memory pool)
+		rave_plays += (mcts_score_u32_t) plays;
+		rave_wins += wins;
+
+		memcpy(&children.rave_plays[i], &rave_plays, sizeof rave_plays);
+		memcpy(&children.rave_wins[i], &rave_wins, sizeof rave_wins);
+	}
 }
 
-void
-agent_mcts_swap(struct agent_mcts *self)
+static inline u64
+mcts_position_key(struct bitboard const *board, enum hex_player player)
+{
+	return board->hash ^ zobrist_turn(player);
+}
+
+static void
+mcts_ttable_seed(struct agent_mcts *self, struct mcts_node *node, struct mcts_node *child, u64 key)
 {
 	assert(self);
+	assert(node);
+	assert(child);
 
-	struct mcts_node old_root = *self->root;
+	u64 data;
+	if (!ttable_probe(&self->ttable, key, &data)) return;
 
-	mem_pool_reset(&self->pool);
+	s32 wins;
+	u32 plays;
+	ttable_unpack_stats(data, &wins, &plays);
 
-	size_t moves = board_available_moves(self->board, NULL);
-	self->root = mem_pool_alloc(&self->pool, alignof(struct mcts_node), mcts_node_sizeof(moves));
-	mcts_node_init(self->root, NULL, hexopponent(old_root.player), old_root.x, old_root.y, moves);
-}
+	if (plays > MCTS_TTABLE_PRIOR_PLAYS) {
+		wins = (s32) ((s64) wins * MCTS_TTABLE_PRIOR_PLAYS / plays);
+		plays = MCTS_TTABLE_PRIOR_PLAYS;
+	}
 
-static bool
-mcts_search(struct agent_mcts *self, struct timespec timeout);
+	/* the prior counts as playouts through every node on the path to the
+	 * child, as a batch would, so that a parent's plays stay the sum of its
+	 * children's in the exploration term and each node's plays match the
+	 * copy kept in its parent's block
+	 */
+	struct mcts_children children = mcts_block_children(mcts_deref(self->pool.ptr, node->block));
+	children.wins[child->index] = wins;
+	children.plays[child->index] = plays;
 
-bool
-agent_mcts_next(struct agent_mcts *self, struct timespec timeout, u32 *out_x, u32 *out_y)
-{
-	assert(self);
-	assert(out_x);
-	assert(out_y);
+	child->plays = plays;
 
-	if (!mcts_search(self, timeout)) return false;
+	/* every level up is scored for the other player */
+	do {
+		wins = -wins;
 
-	struct mcts_node *root = self->pool.ptr;
-	assert(root->children_len);
+		node->plays += plays;
 
-	u32 max_plays = 0;
-	struct mcts_node *best_child = NULL;
-	for (size_t i = 0; i < root->children_cap; i++) {
-		struct mcts_node *child = mcts_node_rel2abs(root, root->children[i]);
-		if (!child) continue;
-
-		if (child->plays > max_plays) {
-			max_plays = child->plays;
-			best_child = child;
-		} else if (child->plays == max_plays && random() % 2) {
-			best_child = child;
+		struct mcts_node *parent = mcts_deref(self->pool.ptr, node->parent);
+		if (parent) {
+			struct mcts_children siblings = mcts_block_children(mcts_deref(self->pool.ptr, parent->block));
+			siblings.plays[node->index] += plays;
+			siblings.wins[node->index] += wins;
 		}
-	}
 
-	assert(best_child);
+		node = parent;
+	} while (node);
+}
+
+static void
+mcts_ttable_update(struct agent_mcts *self, u64 key, s32 reward, u32 lanes)
+{
+	assert(self);
+
+	/* the read-modify-write is not atomic, so concurrent updates of the
+	 * same position may lose a result, which the statistics tolerate
+	 */
+	s32 wins = 0;
+	u32 plays = 0;
+
+	u64 data;
+	if (ttable_probe(&self->ttable, key, &data))
+		ttable_unpack_stats(data, &wins, &plays);
 
-	*out_x = best_child->x;
-	*out_y = best_child->y;
+	if (plays > UINT32_MAX - lanes) return;
 
-	return true;
+	wins += reward;
+	plays += lanes;
+
+	ttable_store(&self->ttable, key, ttable_pack_stats(wins, plays), ttable_stats_priority(plays));
 }
 
 static bool
@@ -256,94 +1309,168 @@ mcts_round(struct agent_mcts *self, struct move *moves)
 {
 	assert(self);
 
-	board_copy(self->board, &self->shadow_board);
+	bitboard_copy(&self->root_board, &self->shadow_board);
 
 	dbglog(LOG_DEBUG, "Starting MCTS round\n");
 
+	u64 phase = stats_cycles();
+
 	/* selection: we walk the mcts tree, picking the child with the highest
 	 * mcts-rave score, until we hit a node with unexpanded children
 	 */
 	struct mcts_node *node = self->root;
-	while (node->children_len == node->children_cap) {
-		struct mcts_node *child = mcts_node_best_child(node);
+	size_t depth = 0;
+	while (node->children_len == node->moves) {
+		struct mcts_node *child = mcts_node_best_child(node, self);
 		if (!child) break;
 
-		if (!board_play(&self->shadow_board, child->player, child->x, child->y)) {
+		if (!bitboard_play(&self->shadow_board, child->player, child->x, child->y)) {
 			dbglog(LOG_WARN, "Failed to play move (%" PRIu32 ", %" PRIu32 ") to shadow board\n", child->x, child->y);
 			return false;
 		}
 
+		self->path[++depth] = mcts_position_key(&self->shadow_board, child->player);
+
 		node = child;
 	}
 
+	u32 selected_depth = depth;
+	phase = stats_phase(&self->stats, STATS_SELECT, phase);
+
 	dbglog(LOG_DEBUG, "Selected node {parent=%p, children=%" PRIu8 ", x=%" PRIu32 ", y=%" PRIu32 "} for expansion\n",
-			  mcts_node_rel2abs(node, node->parent), node->children_len, node->x, node->y);
+			  mcts_deref(self->pool.ptr, node->parent), node->children_len, node->x, node->y);
 
-	size_t moves_len = board_available_moves(&self->shadow_board, moves);
-	shuffle(moves, sizeof *moves, moves_len);
+	/* the moves left after selection are the root's empty cells less the
+	 * (few) cells played along the selected path
+	 */
+	size_t moves_len = 0;
+	for (size_t i = 0; i < self->root_cells_len; i++) {
+		u16 cell = self->root_cells[i];
+		if (bitboard_occupied(&self->shadow_board, cell)) continue;
+
+		moves[moves_len].x = cell % self->geometry.size;
+		moves[moves_len].y = cell / self->geometry.size;
+		moves_len++;
+	}
+	SHUFFLE(moves, moves_len);
 
 	/* expansion: we expand the chosen node, creating a new child for a
 	 * random move
 	 */
 	enum hex_player winner;
-	if (!board_winner(&self->shadow_board, &winner)) {
+	bool expanded = false;
+	if (!bitboard_winner(&self->shadow_board, &winner)) {
+		/* skip moves that are already expanded, as reclaiming a subtree
+		 * leaves a gap among the children of a fully-expanded node
+		 */
+		size_t idx = moves_len;
+		while (idx--) {
+			u16 cell = moves[idx].y * self->geometry.size + moves[idx].x;
+			if (mcts_move_allowed(self, node, cell) && !mcts_node_get_child(node, self, cell)) break;
+		}
+
+		/* a node searched before cells were filled in counted moves
+		 * that no longer exist, and is played out as it stands
+		 */
+		if (idx == SIZE_MAX) {
+			node->moves = node->children_len;
+			goto simulate;
+		}
+
+		SWAP(moves[idx], moves[moves_len - 1]);
+
 		struct move move = moves[--moves_len];
 
-		if (!mcts_node_expand(node, &self->pool, move.x, move.y)) {
-			dbglog(LOG_WARN, "Failed to expand selected node\n");
+		/* the child's moves are the cells left after its own */
+		struct mcts_node *child = mcts_node_expand(node, self, move.x, move.y, moves_len);
+		if (!child) {
+			dbglog(LOG_DEBUG, "Failed to expand selected node\n");
 			return false;
 		}
 
-		struct mcts_node *child = mcts_node_get_child(node, move.x, move.y);
-		assert(child);
-
-		if (!board_play(&self->shadow_board, child->player, child->x, child->y)) {
+		if (!bitboard_play(&self->shadow_board, child->player, child->x, child->y)) {
 			dbglog(LOG_WARN, "Failed to play move (%" PRIu32 ", %" PRIu32 ") to shadow board\n", child->x, child->y);
 			return false;
 		}
+
+		/* a position reached through another move order (or searched
+		 * before this child was last reclaimed) lends the child its
+		 * statistics
+		 */
+		mcts_ttable_seed(self, node, child, mcts_position_key(&self->shadow_board, child->player));
+
+		/* a move that ends the game is proven once, rather than played
+		 * out again in every round that selects it
+		 */
+		if (bitboard_winner(&self->shadow_board, &winner)) mcts_node_prove(child, self, MCTS_PROOF_WIN);
+
+		self->search_nodes++;
+		expanded = true;
+	} else if (node == self->root && !node->proof) {
+		/* filling in captured cells can settle the game at the root
+		 * before either player has connected
+		 */
+		mcts_node_prove(node, self, winner == node->player ? MCTS_PROOF_WIN : MCTS_PROOF_LOSS);
 	}
 
+simulate:
+	phase = stats_phase(&self->stats, STATS_EXPAND, phase);
+
 	dbglog(LOG_DEBUG, "Expanded node {parent=%p, children=%" PRIu8 ", x=%" PRIu32 ", y=%" PRIu32 "}\n",
-			  mcts_node_rel2abs(node, node->parent), node->children_len, node->x, node->y);
+			  mcts_deref(self->pool.ptr, node->parent), node->children_len, node->x, node->y);
 
-	/* simulation: we simulate the game using a uniform random walk of the
-	 * game state space, until a winner is found
+	/* simulation: we simulate a batch of games from the selected node using
+	 * uniform random walks of the game state space, one per vector lane,
+	 * filling every empty cell at once and flood filling a single time to
+	 * find the winner (and the owner of every cell) in each lane
 	 */
-	enum hex_player player = node->player;
-	while (!board_winner(&self->shadow_board, &winner)) {
-		struct move move = moves[--moves_len];
-
-		if (!board_play(&self->shadow_board, player, move.x, move.y)) {
-			dbglog(LOG_WARN, "Failed to play move (%" PRIu32 ", %" PRIu32 ") to shadow board\n", move.x, move.y);
-			return false;
-		}
-
-		player = hexopponent(player);
+	struct playout_batch *batch = &self->batch;
+	if (!bitboard_winner(&self->shadow_board, &winner)) {
+		/* the node's player made the move into it, so their opponent is
+		 * to move, unless the expanded child's move was played after it
+		 */
+		enum hex_player player = expanded ? node->player : hexopponent(node->player);
+		self->playout(&self->shadow_board, player, moves, moves_len, batch);
+	} else {
+		playout_batch_terminal(&self->shadow_board, winner, batch);
+		moves_len = 0;
 	}
 
+	phase = stats_phase(&self->stats, STATS_SIMULATE, phase);
+
 	dbglog(LOG_DEBUG, "Completed playouts for node {parent=%p, children=%" PRIu8 ", x=%" PRIu32 ", y=%" PRIu32 "}\n",
-			  mcts_node_rel2abs(node, node->parent), node->children_len, node->x, node->y);
+			  mcts_deref(self->pool.ptr, node->parent), node->children_len, node->x, node->y);
 
 	/* backpropagation: we update the state information in the mcts tree
-	 * by walking backwards from the selected node
+	 * by walking backwards from the selected node, accumulating the results
+	 * of every lane at once
 	 */
+	mcts_rave_prepare(self, batch);
+
 	do {
-		s32 reward = winner == node->player ? +1 : -1;
+		playout_mask_t won = playout_batch_wins(batch, node->player);
+		s32 reward = 2 * __builtin_popcount(won) - (s32) batch->lanes;
 
-		for (size_t i = 0; i < node->children_len; i++) {
-			struct mcts_node *child = mcts_node_rel2abs(node, node->children[i]);
-			if (!child) continue;
+		mcts_node_update_rave(node, self);
 
-			struct segment *segment = &self->shadow_board.segments[child->y * self->shadow_board.size + child->x];
-			if ((enum cell) child->player == segment->occupant) {
-				child->rave_plays += 1;
-				child->rave_wins += -reward;
-			}
+		node->plays += batch->lanes;
+
+		struct mcts_node *parent = mcts_deref(self->pool.ptr, node->parent);
+		if (parent) {
+			struct mcts_block *siblings_block = mcts_deref(self->pool.ptr, parent->block);
+			struct mcts_children siblings = mcts_block_children(siblings_block);
+
+			siblings.plays[node->index] += batch->lanes;
+			siblings.wins[node->index] += reward;
+
+			mcts_ttable_update(self, self->path[depth--], reward, batch->lanes);
 		}
 
-		node->plays += 1;
-		node->wins += reward;
-	} while ((node = mcts_node_rel2abs(node, node->parent)));
+		node = parent;
+	} while (node);
+
+	stats_phase(&self->stats, STATS_BACKPROP, phase);
+	stats_round(&self->stats, selected_depth, expanded, batch->lanes, moves_len);
 
 	dbglog(LOG_DEBUG, "Completed backpropagation from selected node\n");
 
@@ -353,38 +1480,277 @@ mcts_round(struct agent_mcts *self, struct move *moves)
 }
 
 static bool
-mcts_search(struct agent_mcts *self, struct timespec timeout)
+mcts_step(struct agent_mcts *self, struct move *moves, bool *stalled, size_t *rounds)
+{
+	assert(self);
+	assert(stalled);
+	assert(rounds);
+
+	if (mcts_round(self, moves)) {
+		*stalled = false;
+		(*rounds)++;
+		return true;
+	}
+
+	/* if the previous reclamation did not free a node of a usable size
+	 * class, we have to dig deeper into the tree
+	 */
+	if (*stalled && self->reclaim_threshold < UINT32_MAX / 2)
+		self->reclaim_threshold *= 2;
+
+	if ((*stalled = mcts_reclaim(self))) return true;
+
+	dbglog(LOG_WARN, "Failed to perform MCTS round %zu\n", *rounds + 1);
+	return false;
+}
+
+static void
+mcts_stats_report(struct agent_mcts *self, char const *label, u64 elapsed)
+{
+	assert(self);
+	assert(label);
+
+#if HEXES_STATS
+	/* recycled memory waiting on a free list is what fragments the pool,
+	 * as it can only be reused by allocations of the same size class
+	 */
+	struct stats_pool pool = {
+		.used = self->pool.len,
+		.committed = atomic_load(&self->pool.committed),
+	};
+
+	for (struct mcts_node *node = mcts_deref(self->pool.ptr, self->free_nodes); node;
+	     node = mcts_deref(self->pool.ptr, node->parent))
+		pool.free += sizeof *node;
+
+	for (size_t i = 0; i < MCTS_BLOCK_CLASSES; i++) {
+		size_t size = mcts_block_sizeof((size_t) MCTS_BLOCK_MIN_CAP << i);
+
+		for (struct mcts_block *block = mcts_deref(self->pool.ptr, self->free_blocks[i]); block;
+		     block = mcts_deref(self->pool.ptr, block->cap))
+			pool.free += size;
+	}
+
+	stats_report(&self->stats, label, elapsed, &pool);
+#else
+	(void) self;
+	(void) label;
+	(void) elapsed;
+#endif
+}
+
+/* a proven win settles the move to play, while a proven loss still leaves
+ * the search to find the most stubborn move (unless the root board is
+ * already decided, and so has no move left to search)
+ */
+static bool
+mcts_root_settled(struct agent_mcts *self)
+{
+	assert(self);
+
+	enum hex_player winner;
+	return self->root->proof == MCTS_PROOF_LOSS
+	    || (self->root->proof == MCTS_PROOF_WIN && bitboard_winner(&self->root_board, &winner));
+}
+
+static void *
+mcts_ponder(void *arg)
+{
+	struct agent_mcts *self = arg;
+
+	rng_seed(self->ponder_seed);
+
+	struct move *moves = alloca(self->geometry.cells * sizeof *moves);
+
+	bool stalled = false;
+	while (!atomic_load_explicit(&self->ponder_stop, memory_order_relaxed) && !mcts_root_settled(self)) {
+		if (!mcts_step(self, moves, &stalled, &self->ponder_rounds)) break;
+	}
+
+	return NULL;
+}
+
+void
+agent_mcts_ponder_start(struct agent_mcts *self)
+{
+	assert(self);
+	assert(!self->pondering);
+
+	/* we only ponder the position after our own move, whose children are
+	 * the opponent's replies, and only while the game goes on and the
+	 * root is not already settled (which would stop the thread at once)
+	 */
+	enum hex_player winner;
+	if (self->ponder_unavailable || self->root->player != self->player || !self->root->moves) return;
+
+	mcts_root_load(self);
+	if (bitboard_winner(&self->root_board, &winner) || mcts_root_settled(self)) return;
+
+	self->reclaim_threshold = 1;
+	self->ponder_rounds = 0;
+	self->ponder_seed = rng_next();
+	atomic_store(&self->ponder_stop, false);
+
+	stats_reset(&self->stats);
+	self->ponder_start = timeman_now();
+
+	if (!mcts_thread_create(&self->ponder_thread, mcts_ponder, self)) {
+		dbglog(LOG_WARN, "Failed to start pondering thread, not pondering for the rest of the game\n");
+		self->ponder_unavailable = true;
+		return;
+	}
+
+	self->pondering = true;
+}
+
+void
+agent_mcts_ponder_stop(struct agent_mcts *self)
+{
+	assert(self);
+
+	if (!self->pondering) return;
+
+	atomic_store(&self->ponder_stop, true);
+	pthread_join(self->ponder_thread, NULL);
+
+	self->pondering = false;
+
+	dbglog(LOG_INFO, "Completed %zu rounds of MCTS while pondering (%zu playouts)\n",
+			 self->ponder_rounds, self->ponder_rounds * PLAYOUT_LANES);
+
+	mcts_stats_report(self, "ponder", timeman_now() - self->ponder_start);
+}
+
+static void
+mcts_root_top_plays(struct agent_mcts *self, u32 *out_best, u32 *out_second)
+{
+	assert(self);
+	assert(out_best);
+	assert(out_second);
+
+	struct mcts_node *root = self->root;
+
+	u32 best = 0, second = 0;
+	if (root->children_len) {
+		struct mcts_children children = mcts_block_children(mcts_deref(self->pool.ptr, root->block));
+
+		for (size_t i = 0; i < root->children_len; i++) {
+			if (children.plays[i] > best) {
+				second = best;
+				best = children.plays[i];
+			} else if (children.plays[i] > second) {
+				second = children.plays[i];
+			}
+		}
+	}
+
+	*out_best = best;
+	*out_second = second;
+}
+
+static bool
+mcts_search_done(struct agent_mcts *self, struct timeman_deadline const *deadline,
+		 u64 elapsed, size_t rounds, bool *extended)
+{
+	assert(self);
+	assert(deadline);
+	assert(extended);
+
+	u32 best, second;
+	mcts_root_top_plays(self, &best, &second);
+
+	/* past the soft deadline, we only keep searching while the best move
+	 * is still in doubt
+	 */
+	if (elapsed >= deadline->soft) {
+		if (elapsed >= deadline->hard || (f32) second < MCTS_CONTESTED_RATIO * (f32) best) {
+			dbglog(LOG_DEBUG, "Search timeout elapsed\n");
+			return true;
+		}
+
+		*extended = true;
+		return false;
+	}
+
+	/* before it, we stop once the runner-up could not catch up with the
+	 * best move even if it won every remaining round at the current rate,
+	 * leaving the unspent time on the game timer for later moves. while
+	 * the race is contested, the search may run on to the hard deadline,
+	 * so the runner-up has until then to catch up
+	 */
+	if (!rounds || !elapsed) return false;
+
+	bool contested = (f32) second >= MCTS_CONTESTED_RATIO * (f32) best;
+	u64 limit = contested ? deadline->hard : deadline->soft;
+
+	u64 remaining = (limit - elapsed) * rounds / elapsed * PLAYOUT_LANES;
+	if (best - second <= remaining) return false;
+
+	dbglog(LOG_INFO, "Best move cannot be overtaken, stopping search early (%.3f seconds saved)\n",
+			 (double) (limit - elapsed) / NANOSECS);
+
+	return true;
+}
+
+static bool
+mcts_search(struct agent_mcts *self, struct timeman_budget const *budget)
 {
 	assert(self);
+	assert(budget);
 
 	struct move *moves = alloca(self->board->size * self->board->size * sizeof *moves);
 
-	struct timespec time;
-	clock_gettime(CLOCK_MONOTONIC, &time);
+	mcts_root_load(self);
 
-	u64 end_nanos = TIMESPEC_TO_NANOS(time.tv_sec, time.tv_nsec)
-		      + TIMESPEC_TO_NANOS(timeout.tv_sec, timeout.tv_nsec);
+	dbglog(LOG_INFO, "Starting MCTS tree search with %.3f second budget (%.3f seconds hard limit)\n",
+			 (double) budget->soft / NANOSECS, (double) budget->hard / NANOSECS);
 
-	dbglog(LOG_INFO, "Starting MCTS tree search with %" PRIu32 " second timeout\n", timeout.tv_sec);
+	self->reclaim_threshold = 1;
+	self->reclaimed_nodes = self->reclaimed_bytes = 0;
+
+	self->search_nodes = 0;
+
+	stats_reset(&self->stats);
+
+	struct timeman_deadline deadline;
+	timeman_deadline_init(&deadline, budget);
 
 	size_t rounds = 0;
+	bool stalled = false, extended = false;
+	u64 elapsed = 0;
 	while (true) {
-		clock_gettime(CLOCK_MONOTONIC, &time);
-		if (end_nanos <= TIMESPEC_TO_NANOS(time.tv_sec, time.tv_nsec)) {
-			dbglog(LOG_DEBUG, "Search timeout elapsed\n");
+		/* once the root is settled, no further round can change the move */
+		if (mcts_root_settled(self)) {
+			dbglog(LOG_INFO, "MCTS root proven %s after %zu rounds\n",
+					 self->root->proof == MCTS_PROOF_LOSS ? "won" : "lost", rounds);
 			break;
 		}
 
-		if (!mcts_round(self, moves)) {
-			dbglog(LOG_WARN, "Failed to perform MCTS round %zu\n", rounds + 1);
+		if (budget->rounds) {
+			if (rounds >= budget->rounds) break;
+		} else if (timeman_deadline_poll(&deadline, &elapsed) && mcts_search_done(self, &deadline, elapsed, rounds, &extended)) {
 			break;
 		}
 
-		rounds++;
+		if (!mcts_step(self, moves, &stalled, &rounds)) break;
 	}
 
-	dbglog(LOG_INFO, "Completed %zu rounds of MCTS\n", rounds);
-	dbglog(LOG_INFO, "MCTS node pool occupancy: %zu/%zu bytes allocated\n", self->pool.len, self->pool.cap);
+	elapsed = timeman_now() - deadline.start;
+
+	self->search_rounds = rounds;
+	self->search_nanos = elapsed;
+
+	dbglog(LOG_INFO, "Completed %zu rounds of MCTS (%zu playouts) in %.3f seconds%s\n",
+			 rounds, rounds * PLAYOUT_LANES, (double) elapsed / NANOSECS, extended ? " (extended)" : "");
+	struct memory_usage usage = {0};
+	memory_usage(&usage);
+
+	dbglog(LOG_INFO, "MCTS node pool high-water mark: %zu bytes (%zu committed, %zu capacity), process data: %zu bytes, resident: %zu bytes\n",
+			 self->pool.len, atomic_load(&self->pool.committed), self->pool.cap, usage.data, usage.resident);
+	dbglog(LOG_INFO, "MCTS node pool recycling: %zu nodes (%zu bytes) reclaimed, visit threshold %" PRIu32 "\n",
+			 self->reclaimed_nodes, self->reclaimed_bytes, self->reclaim_threshold);
+
+	mcts_stats_report(self, "search", elapsed);
 
 	return true;
 }
@@ -19,7 +19,7 @@ agent_random_init(struct agent_random *self, struct board const *board)
 		}
 	}
 
-	shuffle(self->moves, sizeof *self->moves, self->len);
+	SHUFFLE(self->moves, self->len);
 
 	return true;
 }
@@ -41,7 +41,8 @@ agent_random_play(struct agent_random *self, enum hex_player player, u32 x, u32
 
 	for (size_t i = 0; i < self->len; i++) {
 		if (self->moves[i].x == x && self->moves[i].y == y) {
-			swap(&self->moves[i], &self->moves[--self->len], sizeof *self->moves);
+			SWAP(self->moves[i], self->moves[self->len - 1]);
+			self->len--;
 			break;
 		}
 	}
@@ -58,13 +59,13 @@ agent_random_swap(struct agent_random *self)
 }
 
 bool
-agent_random_next(struct agent_random *self, struct timespec timeout, u32 *out_x, u32 *out_y)
+agent_random_next(struct agent_random *self, struct timeman_budget const *budget, u32 *out_x, u32 *out_y)
 {
 	assert(self);
 	assert(out_x);
 	assert(out_y);
 
-	(void) timeout;
+	(void) budget;
 
 	if (!self->len) return false;
 
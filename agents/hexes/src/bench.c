@@ -0,0 +1,232 @@
+#include "hexes/bench.h"
+
+#include "hexes/rng.h"
+#include "hexes/threadpool.h"
+#include "hexes/timeman.h"
+
+/* openings and middlegames on the common board sizes, so that both the
+ * wide-open and the crowded cases of every size are measured
+ */
+static struct bench_position const bench_suite[] = {
+	{ 9,  "" },
+	{ 9,  "e5 d6 c7 f4 e3 d4 g3 c5" },
+	{ 11, "" },
+	{ 11, "f6 e7 g5 d8 f8 h4 c9 i3" },
+	{ 11, "f6 e7 g5 d8 f8 h4 c9 i3 e6 g4 d7 j2 b10 h5 g6 c8" },
+	{ 13, "" },
+	{ 13, "g7 f8 h6 e9 i5 d10 f9 j4" },
+	{ 19, "j10 k9 i11 l8" },
+};
+
+struct bench_result {
+	size_t empty, rounds, nodes;
+	u64 nanos;
+};
+
+static bool
+bench_parse_moves(struct board *board, char const *moves, enum hex_player *out)
+{
+	assert(board);
+	assert(moves);
+	assert(out);
+
+	enum hex_player player = HEX_PLAYER_BLACK;
+
+	char const *ptr = moves;
+	while (*ptr) {
+		if (*ptr == ' ') {
+			ptr++;
+			continue;
+		}
+
+		if (*ptr < 'a' || *ptr > 'z') return false;
+
+		u32 x = (u32) (*ptr++ - 'a');
+
+		char *end;
+		unsigned long row = strtoul(ptr, &end, 10);
+		if (end == ptr || row == 0) return false;
+
+		ptr = end;
+
+		if (!board_play(board, player, x, (u32) row - 1)) return false;
+
+		player = hexopponent(player);
+	}
+
+	*out = player;
+
+	return true;
+}
+
+static bool
+bench_position(struct bench_position const *position, struct timeman_budget const *budget,
+	       u64 seed, u32 mem_limit_mib, struct bench_result *out)
+{
+	assert(position);
+	assert(budget);
+	assert(out);
+
+	/* the agent is far too large for the stack */
+	static struct agent_mcts agent;
+
+	struct threadpool threadpool;
+	struct board board;
+
+	bool res = false;
+
+	if (!threadpool_init(&threadpool, 0)) return false;
+
+	if (!board_init(&board, position->size)) {
+		dbglog(LOG_ERROR, "Failed to initialise board of size %" PRIu32 "\n", position->size);
+		goto error_threadpool;
+	}
+
+	enum hex_player player;
+	if (!bench_parse_moves(&board, position->moves, &player)) {
+		dbglog(LOG_ERROR, "Invalid bench position: \"%s\"\n", position->moves);
+		goto error_board;
+	}
+
+	if (!agent_mcts_init(&agent, &board, &threadpool, mem_limit_mib, player)) {
+		dbglog(LOG_ERROR, "Failed to initialise agent\n");
+		goto error_board;
+	}
+
+	rng_seed(seed);
+
+	u32 x, y;
+	if (!agent_mcts_next(&agent, budget, &x, &y)) {
+		dbglog(LOG_ERROR, "Failed to search bench position\n");
+		goto error_agent;
+	}
+
+	out->empty = board_available_moves(&board, NULL);
+	out->rounds = agent.search_rounds;
+	out->nodes = agent.search_nodes;
+	out->nanos = agent.search_nanos;
+
+	res = true;
+
+error_agent:
+	agent_mcts_free(&agent);
+error_board:
+	board_free(&board);
+error_threadpool:
+	threadpool_free(&threadpool);
+
+	return res;
+}
+
+static void
+bench_report(char const *label, u32 size, struct bench_result const *result)
+{
+	assert(label);
+	assert(result);
+
+	/* the totals span every board size */
+	char size_str[16] = "-";
+	if (size) snprintf(size_str, sizeof size_str, "%" PRIu32, size);
+
+	double secs = (double) result->nanos / NANOSECS;
+	double rate = secs > 0.0 ? 1.0 / secs : 0.0;
+
+	printf("%-8s %4s %5zu %9zu %9zu %8.3f %11.0f %11.0f %11.0f\n",
+	       label, size_str, result->empty, result->rounds, result->nodes, secs,
+	       (double) result->rounds * rate,
+	       (double) (result->rounds * PLAYOUT_LANES) * rate,
+	       (double) result->nodes * rate);
+}
+
+bool
+bench_run(int argc, char **argv)
+{
+	struct timeman_budget budget = {
+		.soft = UINT64_MAX,
+		.hard = UINT64_MAX,
+		.rounds = BENCH_DEFAULT_ROUNDS,
+	};
+
+	u64 seed = BENCH_DEFAULT_SEED;
+	u32 mem_limit_mib = BENCH_DEFAULT_MEM_MIB;
+
+	char const *optstr = "r:t:s:m:P:";
+
+	optind = 1;
+
+	int opt;
+	while ((opt = getopt(argc, argv, optstr)) != -1) {
+		switch (opt) {
+		case 'r':
+			budget.rounds = strtoull(optarg, NULL, 10);
+			if (!budget.rounds) goto error;
+			break;
+
+		case 't': {
+			u64 millis = strtoull(optarg, NULL, 10);
+			if (!millis) goto error;
+
+			budget.soft = budget.hard = millis * 1000 * 1000;
+			budget.rounds = 0;
+		} break;
+
+		case 's':
+			seed = strtoull(optarg, NULL, 0);
+			break;
+
+		case 'm':
+			mem_limit_mib = (u32) strtoul(optarg, NULL, 10);
+			if (!mem_limit_mib) goto error;
+			break;
+
+		case 'P': {
+			enum playout_policy policy;
+			if (!playout_policy_parse(optarg, &policy)) goto error;
+
+			opts.playout_policy = policy;
+		} break;
+
+		default: goto error;
+		}
+	}
+
+	if (optind != argc) goto error;
+
+	char const *policy = playout_policy_str((enum playout_policy) opts.playout_policy);
+
+	if (budget.rounds) {
+		printf("bench: %zu rounds per position, seed 0x%" PRIx64 ", %" PRIu32 " MiB, %s playouts\n",
+		       budget.rounds, seed, mem_limit_mib, policy);
+	} else {
+		printf("bench: %.3f seconds per position, seed 0x%" PRIx64 ", %" PRIu32 " MiB, %s playouts\n",
+		       (double) budget.soft / NANOSECS, seed, mem_limit_mib, policy);
+	}
+
+	printf("%-8s %4s %5s %9s %9s %8s %11s %11s %11s\n",
+	       "position", "size", "empty", "rounds", "nodes", "secs", "rounds/s", "playouts/s", "nodes/s");
+
+	struct bench_result total = {0};
+	for (size_t i = 0; i < ARRLEN(bench_suite); i++) {
+		struct bench_result result;
+		if (!bench_position(&bench_suite[i], &budget, seed, mem_limit_mib, &result))
+			return false;
+
+		char label[16];
+		snprintf(label, sizeof label, "%zu", i);
+		bench_report(label, bench_suite[i].size, &result);
+
+		total.empty += result.empty;
+		total.rounds += result.rounds;
+		total.nodes += result.nodes;
+		total.nanos += result.nanos;
+	}
+
+	bench_report("total", 0, &total);
+
+	return true;
+
+error:
+	fprintf(stderr, "Usage: hexes bench [-r rounds | -t millis] [-s seed] [-m mem-mib] [-P random|bridge]\n");
+
+	return false;
+}
@@ -0,0 +1,373 @@
+#include "hexes/bitboard.h"
+
+#include "hexes/zobrist.h"
+
+extern inline bool
+bitboard_supported(u32 size);
+
+extern inline bool
+bitboard_occupied(struct bitboard const *self, u32 idx);
+
+extern inline bool
+bitboard_set_test(struct bitboard_geometry const *geometry, union bitboard_set const *set, u32 x, u32 y);
+
+static inline u128
+bb128_bit(u32 idx)
+{
+	return (u128) 1 << idx;
+}
+
+static inline u128
+bb128_neighbours(struct bitboard_geometry const *geometry, u128 set)
+{
+	u32 n = geometry->size;
+
+	u128 l = set & geometry->not_first_col.narrow;
+	u128 r = set & geometry->not_last_col.narrow;
+
+	return ((l >> 1) | (r << 1) |
+		(set >> n) | (set << n) |
+		(l << (n - 1)) | (r >> (n - 1))) & geometry->mask.narrow;
+}
+
+static inline u128
+bb128_flood(struct bitboard_geometry const *geometry, u128 seed, u128 own)
+{
+	u128 prev;
+	do {
+		prev = seed;
+		seed |= bb128_neighbours(geometry, seed) & own;
+	} while (seed != prev);
+
+	return seed;
+}
+
+static inline void
+bbwide_bit(struct bitset *out, u32 words, u32 idx)
+{
+	for (u32 i = 0; i < words; i++)
+		out->words[i] = 0;
+
+	out->words[idx / BITSET_WORD_BITS] = (u64) 1 << (idx % BITSET_WORD_BITS);
+}
+
+static inline bool
+bbwide_intersects(struct bitset const *lhs, struct bitset const *rhs, u32 words)
+{
+	u64 acc = 0;
+	for (u32 i = 0; i < words; i++)
+		acc |= lhs->words[i] & rhs->words[i];
+
+	return acc;
+}
+
+static inline void
+bbwide_neighbours(struct bitboard_geometry const *geometry, struct bitset const *set, struct bitset *out)
+{
+	u32 n = geometry->size, words = geometry->words;
+
+	struct bitset l, r;
+	for (u32 i = 0; i < words; i++) {
+		l.words[i] = set->words[i] & geometry->not_first_col.wide.words[i];
+		r.words[i] = set->words[i] & geometry->not_last_col.wide.words[i];
+	}
+
+	/* shifts towards higher cell indices carry in from the word below,
+	 * and shifts towards lower cell indices carry in from the word above
+	 */
+#define SHL(s, i, k) (((s)->words[i] << (k)) | ((i) ? (s)->words[(i) - 1] >> (BITSET_WORD_BITS - (k)) : 0))
+#define SHR(s, i, k) (((s)->words[i] >> (k)) | ((i) + 1 < words ? (s)->words[(i) + 1] << (BITSET_WORD_BITS - (k)) : 0))
+
+	for (u32 i = 0; i < words; i++) {
+		out->words[i] = (SHR(&l, i, 1) | SHL(&r, i, 1) |
+				 SHR(set, i, n) | SHL(set, i, n) |
+				 SHL(&l, i, n - 1) | SHR(&r, i, n - 1)) & geometry->mask.wide.words[i];
+	}
+
+#undef SHR
+#undef SHL
+}
+
+static inline void
+bbwide_flood(struct bitboard_geometry const *geometry, struct bitset *seed, struct bitset const *own)
+{
+	u32 words = geometry->words;
+
+	struct bitset neighbours;
+	bool changed;
+	do {
+		bbwide_neighbours(geometry, seed, &neighbours);
+
+		changed = false;
+		for (u32 i = 0; i < words; i++) {
+			u64 next = seed->words[i] | (neighbours.words[i] & own->words[i]);
+			changed |= next != seed->words[i];
+			seed->words[i] = next;
+		}
+	} while (changed);
+}
+
+static void
+bitboard_set_cell(struct bitboard_geometry const *geometry, union bitboard_set *set, u32 idx)
+{
+	if (geometry->narrow) {
+		set->narrow |= bb128_bit(idx);
+	} else {
+		set->wide.words[idx / BITSET_WORD_BITS] |= (u64) 1 << (idx % BITSET_WORD_BITS);
+	}
+}
+
+bool
+bitboard_geometry_init(struct bitboard_geometry *self, u32 size)
+{
+	assert(self);
+
+	if (!bitboard_supported(size)) return false;
+
+	zobrist_init();
+
+	memset(self, 0, sizeof *self);
+
+	self->size = size;
+	self->cells = size * size;
+	self->words = (self->cells + BITSET_WORD_BITS - 1) / BITSET_WORD_BITS;
+	self->narrow = size <= BITBOARD_NARROW_MAX_SIZE;
+
+	for (u32 y = 0; y < size; y++) {
+		for (u32 x = 0; x < size; x++) {
+			u32 idx = y * size + x;
+
+			bitboard_set_cell(self, &self->mask, idx);
+
+			if (x != 0) bitboard_set_cell(self, &self->not_first_col, idx);
+			if (x != size - 1) bitboard_set_cell(self, &self->not_last_col, idx);
+
+			if (x == 0) bitboard_set_cell(self, &self->edges[BLACK_SOURCE], idx);
+			if (x == size - 1) bitboard_set_cell(self, &self->edges[BLACK_SINK], idx);
+			if (y == 0) bitboard_set_cell(self, &self->edges[WHITE_SOURCE], idx);
+			if (y == size - 1) bitboard_set_cell(self, &self->edges[WHITE_SINK], idx);
+
+			for (u32 i = 0; i < PATTERN_NEIGHBOURS; i++) {
+				s64 nx = (s64) x + pattern_dx[i], ny = (s64) y + pattern_dy[i];
+
+				if (0 <= nx && nx < size && 0 <= ny && ny < size) {
+					self->ring[idx][i] = (u16) (ny * size + nx);
+				} else {
+					self->ring[idx][i] = (u16) (self->cells + pattern_edge(size, nx, ny));
+				}
+			}
+		}
+	}
+
+	return true;
+}
+
+void
+bitboard_init(struct bitboard *self, struct bitboard_geometry const *geometry)
+{
+	assert(self);
+	assert(geometry);
+
+	memset(self, 0, sizeof *self);
+
+	self->geometry = geometry;
+}
+
+void
+bitboard_copy(struct bitboard const *restrict self, struct bitboard *restrict other)
+{
+	assert(self);
+	assert(other);
+
+	struct bitboard_geometry const *geometry = self->geometry;
+
+	other->geometry = geometry;
+
+	if (geometry->narrow) {
+		for (size_t i = 0; i < 2; i++) {
+			other->stones[i].narrow = self->stones[i].narrow;
+			other->reach[i].narrow = self->reach[i].narrow;
+		}
+	} else {
+		size_t bytes = geometry->words * sizeof(u64);
+		for (size_t i = 0; i < 2; i++) {
+			memcpy(other->stones[i].wide.words, self->stones[i].wide.words, bytes);
+			memcpy(other->reach[i].wide.words, self->reach[i].wide.words, bytes);
+		}
+	}
+
+	other->hash = self->hash;
+}
+
+void
+bitboard_load(struct bitboard *self, struct board const *board)
+{
+	assert(self);
+	assert(board);
+	assert(self->geometry->size == board->size);
+
+	bitboard_init(self, self->geometry);
+
+	/* the occupied cells are exactly those past the end of the board's
+	 * empty cell array
+	 */
+	size_t cells = board->size * board->size;
+	for (size_t i = board->empty_len; i < cells; i++) {
+		u32 idx = board->empty[i];
+		enum cell occupant = board->segments[idx].occupant;
+
+		bitboard_play(self, (enum hex_player) occupant, idx % board->size, idx / board->size);
+	}
+}
+
+static inline enum board_edges
+bitboard_source(enum hex_player player)
+{
+	return player == HEX_PLAYER_BLACK ? BLACK_SOURCE : WHITE_SOURCE;
+}
+
+static inline enum board_edges
+bitboard_sink(enum hex_player player)
+{
+	return player == HEX_PLAYER_BLACK ? BLACK_SINK : WHITE_SINK;
+}
+
+bool
+bitboard_play(struct bitboard *self, enum hex_player player, u32 x, u32 y)
+{
+	assert(self);
+
+	struct bitboard_geometry const *geometry = self->geometry;
+	assert(x < geometry->size && y < geometry->size);
+
+	u32 idx = y * geometry->size + x;
+	union bitboard_set *stones = &self->stones[player], *reach = &self->reach[player];
+	union bitboard_set const *source = &geometry->edges[bitboard_source(player)];
+
+	/* a new stone only extends the set of stones connected to the source
+	 * edge if it touches that set (or the edge itself), in which case we
+	 * flood outwards through the player's stones from the new stone
+	 */
+	if (geometry->narrow) {
+		u128 bit = bb128_bit(idx);
+
+		if ((self->stones[HEX_PLAYER_BLACK].narrow | self->stones[HEX_PLAYER_WHITE].narrow) & bit)
+			return false;
+
+		stones->narrow |= bit;
+
+		if ((bit & source->narrow) || (bb128_neighbours(geometry, bit) & reach->narrow))
+			reach->narrow = bb128_flood(geometry, reach->narrow | bit, stones->narrow);
+	} else {
+		u32 word = idx / BITSET_WORD_BITS;
+		u64 mask = (u64) 1 << (idx % BITSET_WORD_BITS);
+
+		if ((self->stones[HEX_PLAYER_BLACK].wide.words[word] | self->stones[HEX_PLAYER_WHITE].wide.words[word]) & mask)
+			return false;
+
+		stones->wide.words[word] |= mask;
+
+		struct bitset bit, neighbours;
+		bbwide_bit(&bit, geometry->words, idx);
+		bbwide_neighbours(geometry, &bit, &neighbours);
+
+		if ((source->wide.words[word] & mask) || bbwide_intersects(&neighbours, &reach->wide, geometry->words)) {
+			reach->wide.words[word] |= mask;
+			bbwide_flood(geometry, &reach->wide, &stones->wide);
+		}
+	}
+
+	self->hash ^= zobrist_cell(player, idx);
+
+	return true;
+}
+
+enum cell
+bitboard_cell(struct bitboard const *self, u32 x, u32 y)
+{
+	assert(self);
+
+	struct bitboard_geometry const *geometry = self->geometry;
+	assert(x < geometry->size && y < geometry->size);
+
+	u32 idx = y * geometry->size + x;
+
+	for (size_t i = 0; i < 2; i++) {
+		bool occupied = geometry->narrow
+			      ? (self->stones[i].narrow >> idx) & 1
+			      : (self->stones[i].wide.words[idx / BITSET_WORD_BITS] >> (idx % BITSET_WORD_BITS)) & 1;
+
+		if (occupied) return (enum cell) i;
+	}
+
+	return CELL_EMPTY;
+}
+
+static inline size_t
+bitboard_extract_moves(u64 word, u32 base, u32 size, struct move *buf, size_t idx)
+{
+	if (!buf) return idx + __builtin_popcountll(word);
+
+	while (word) {
+		u32 cell = base + __builtin_ctzll(word);
+		word &= word - 1;
+
+		buf[idx].x = cell % size;
+		buf[idx].y = cell / size;
+		idx++;
+	}
+
+	return idx;
+}
+
+size_t
+bitboard_available_moves(struct bitboard const *self, struct move *buf)
+{
+	assert(self);
+
+	struct bitboard_geometry const *geometry = self->geometry;
+
+	size_t idx = 0;
+	if (geometry->narrow) {
+		u128 empty = geometry->mask.narrow
+			   & ~(self->stones[HEX_PLAYER_BLACK].narrow | self->stones[HEX_PLAYER_WHITE].narrow);
+
+		idx = bitboard_extract_moves((u64) empty, 0, geometry->size, buf, idx);
+		idx = bitboard_extract_moves((u64) (empty >> BITSET_WORD_BITS), BITSET_WORD_BITS, geometry->size, buf, idx);
+	} else {
+		for (u32 i = 0; i < geometry->words; i++) {
+			u64 empty = geometry->mask.wide.words[i]
+				  & ~(self->stones[HEX_PLAYER_BLACK].wide.words[i] | self->stones[HEX_PLAYER_WHITE].wide.words[i]);
+
+			idx = bitboard_extract_moves(empty, i * BITSET_WORD_BITS, geometry->size, buf, idx);
+		}
+	}
+
+	return idx;
+}
+
+bool
+bitboard_winner(struct bitboard const *self, enum hex_player *out)
+{
+	assert(self);
+	assert(out);
+
+	struct bitboard_geometry const *geometry = self->geometry;
+
+	enum hex_player players[] = { HEX_PLAYER_BLACK, HEX_PLAYER_WHITE, };
+	for (size_t i = 0; i < ARRLEN(players); i++) {
+		union bitboard_set const *reach = &self->reach[players[i]];
+		union bitboard_set const *sink = &geometry->edges[bitboard_sink(players[i])];
+
+		bool connected = geometry->narrow
+			       ? (reach->narrow & sink->narrow) != 0
+			       : bbwide_intersects(&reach->wide, &sink->wide, geometry->words);
+
+		if (connected) {
+			*out = players[i];
+			return true;
+		}
+	}
+
+	return false;
+}
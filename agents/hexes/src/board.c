@@ -1,5 +1,7 @@
 #include "hexes/board.h"
 
+#include "hexes/zobrist.h"
+
 #define NEIGHBOUR_COUNT 6
 
 extern inline segment_relptr_t
@@ -29,6 +31,17 @@ segment_root(struct segment *self)
 	return self;
 }
 
+static struct segment *
+segment_find(struct segment *self)
+{
+	assert(self);
+
+	struct segment *parent;
+	while ((parent = segment_rel2abs(self, self->parent))) self = parent;
+
+	return self;
+}
+
 bool
 segment_merge(struct segment *self, struct segment *elem)
 {
@@ -64,17 +77,252 @@ board_white_source(struct board *self);
 extern inline struct segment *
 board_white_sink(struct board *self);
 
+static inline bool
+board_neighbour(struct board const *self, u32 x, u32 y, u32 dir, u32 *out)
+{
+	s64 px = x + pattern_dx[dir];
+	s64 py = y + pattern_dy[dir];
+
+	if (px < 0 || px >= self->size || py < 0 || py >= self->size) return false;
+
+	*out = py * self->size + px;
+	return true;
+}
+
+static pattern_code_t
+board_pattern_code(struct board const *self, u32 x, u32 y)
+{
+	pattern_code_t code = 0;
+	for (u32 i = 0; i < PATTERN_NEIGHBOURS; i++) {
+		enum pattern_state state;
+
+		u32 idx;
+		if (!board_neighbour(self, x, y, i, &idx)) {
+			state = pattern_edge(self->size, (s64) x + pattern_dx[i], (s64) y + pattern_dy[i]);
+		} else if (self->segments[idx].occupant == CELL_EMPTY) {
+			state = PATTERN_EMPTY;
+		} else {
+			state = pattern_stone((enum hex_player) self->segments[idx].occupant);
+		}
+
+		code = pattern_set(code, i, state);
+	}
+
+	return code;
+}
+
+/* dead and vulnerable cells, which depend only on their own neighbourhood */
+static void
+board_classify_dead(struct board *self, u32 idx)
+{
+	u8 *flags = &self->inferior[idx];
+	*flags &= ~(INFERIOR_DEAD | INFERIOR_VULNERABLE_BLACK | INFERIOR_VULNERABLE_WHITE);
+
+	if (self->segments[idx].occupant != CELL_EMPTY) return;
+
+	pattern_code_t code = self->codes[idx];
+	if (pattern_dead(code)) *flags |= INFERIOR_DEAD;
+
+	u32 x = idx % self->size, y = idx / self->size;
+	for (u32 i = 0; i < PATTERN_NEIGHBOURS; i++) {
+		u32 neighbour;
+		if (!board_neighbour(self, x, y, i, &neighbour)) continue;
+		if (self->segments[neighbour].occupant != CELL_EMPTY) continue;
+
+		for (u32 p = 0; p < 2; p++) {
+			if (pattern_dead(pattern_set(code, i, pattern_stone(p))))
+				*flags |= INFERIOR_VULNERABLE(p);
+		}
+	}
+}
+
+/* the empty neighbours that form a captured pair with the cell, where a
+ * stone of the capturing player on either cell kills the other one
+ */
+static u32
+board_capture_partners(struct board const *self, u32 idx, u32 *out_dir, enum hex_player *out_player)
+{
+	u32 x = idx % self->size, y = idx / self->size;
+	pattern_code_t code = self->codes[idx];
+
+	u32 partners = 0;
+	for (u32 i = 0; i < PATTERN_NEIGHBOURS; i++) {
+		u32 neighbour;
+		if (!board_neighbour(self, x, y, i, &neighbour)) continue;
+		if (self->segments[neighbour].occupant != CELL_EMPTY) continue;
+
+		for (u32 p = 0; p < 2; p++) {
+			enum pattern_state stone = pattern_stone(p);
+
+			if (!pattern_dead(pattern_set(code, i, stone))) continue;
+			if (!pattern_dead(pattern_set(self->codes[neighbour], pattern_opposite(i), stone))) continue;
+
+			*out_dir = i;
+			*out_player = p;
+			partners++;
+		}
+	}
+
+	return partners;
+}
+
+/* captured cells, which depend on the neighbourhoods of their neighbours.
+ * as a cell can only answer one intrusion, we only accept pairs whose cells
+ * have no other partner
+ */
+static void
+board_classify_captured(struct board *self, u32 idx)
+{
+	u8 *flags = &self->inferior[idx];
+	*flags &= ~(INFERIOR_CAPTURED_BLACK | INFERIOR_CAPTURED_WHITE);
+
+	if (self->segments[idx].occupant != CELL_EMPTY) return;
+
+	u32 dir, partner_dir;
+	enum hex_player player, partner_player;
+	if (board_capture_partners(self, idx, &dir, &player) != 1) return;
+
+	u32 partner;
+	board_neighbour(self, idx % self->size, idx / self->size, dir, &partner);
+
+	if (board_capture_partners(self, partner, &partner_dir, &partner_player) != 1) return;
+
+	*flags |= INFERIOR_CAPTURED(player);
+}
+
+/* dominated cells, which depend on whether their killers are inferior */
+static void
+board_classify_dominated(struct board *self, u32 idx)
+{
+	u8 *flags = &self->inferior[idx];
+	*flags &= ~(INFERIOR_DOMINATED_BLACK | INFERIOR_DOMINATED_WHITE);
+
+	if (self->segments[idx].occupant != CELL_EMPTY || (*flags & INFERIOR_FILLIN)) return;
+
+	/* a killer that is itself vulnerable might be dominated in turn, and
+	 * we never want to prune both sides of such a chain (or cycle)
+	 */
+	u32 x = idx % self->size, y = idx / self->size;
+	pattern_code_t code = self->codes[idx];
+
+	for (u32 i = 0; i < PATTERN_NEIGHBOURS; i++) {
+		u32 killer;
+		if (!board_neighbour(self, x, y, i, &killer)) continue;
+		if (self->segments[killer].occupant != CELL_EMPTY) continue;
+
+		for (u32 p = 0; p < 2; p++) {
+			if (self->inferior[killer] & (INFERIOR_FILLIN | INFERIOR_VULNERABLE(p))) continue;
+
+			if (pattern_dead(pattern_set(code, i, pattern_stone(p))))
+				*flags |= INFERIOR_DOMINATED(p);
+		}
+	}
+}
+
+/* every classification reads the one before it, out to the given distance
+ * from the cells whose neighbourhood changed
+ */
+static void
+board_classify_region(struct board *self, u32 x, u32 y, s64 radius, void (*classify)(struct board *, u32))
+{
+	for (s64 dy = -radius; dy <= radius; dy++) {
+		for (s64 dx = -radius; dx <= radius; dx++) {
+			if (llabs(dx + dy) > radius) continue;
+
+			s64 px = x + dx, py = y + dy;
+			if (px < 0 || px >= self->size || py < 0 || py >= self->size) continue;
+
+			classify(self, py * self->size + px);
+		}
+	}
+}
+
+static void
+board_patterns_reset(struct board *self)
+{
+	size_t cells = self->size * self->size;
+
+	for (size_t i = 0; i < cells; i++) {
+		self->codes[i] = board_pattern_code(self, i % self->size, i / self->size);
+		self->inferior[i] = 0;
+	}
+
+	for (size_t i = 0; i < cells; i++) board_classify_dead(self, i);
+	for (size_t i = 0; i < cells; i++) board_classify_captured(self, i);
+	for (size_t i = 0; i < cells; i++) board_classify_dominated(self, i);
+}
+
+static void
+board_patterns_update(struct board *self, enum hex_player player, u32 x, u32 y)
+{
+	for (u32 i = 0; i < PATTERN_NEIGHBOURS; i++) {
+		u32 neighbour;
+		if (board_neighbour(self, x, y, i, &neighbour))
+			self->codes[neighbour] = pattern_set(self->codes[neighbour], pattern_opposite(i), pattern_stone(player));
+	}
+
+	/* a neighbourhood only changed next to the move, captured pairs read
+	 * the neighbourhoods of both of their cells, and dominated cells read
+	 * whether their killers are captured
+	 */
+	board_classify_region(self, x, y, 1, board_classify_dead);
+	board_classify_region(self, x, y, 3, board_classify_captured);
+	board_classify_region(self, x, y, 4, board_classify_dominated);
+}
+
 bool
 board_init(struct board *self, u32 size)
 {
 	assert(self);
 
+	if (size > BOARD_MAX_SIZE) return false;
+
+	zobrist_init();
+
 	self->size = size;
+	self->hash = 0;
 
-	size_t segments = (size * size) + _BOARD_EDGE_COUNT;
+	size_t cells = size * size;
+	size_t segments = cells + _BOARD_EDGE_COUNT;
 	if (!(self->segments = malloc(segments * sizeof *self->segments)))
 		return false;
 
+	if (!(self->empty = malloc(2 * cells * sizeof *self->empty))) {
+		free(self->segments);
+		return false;
+	}
+
+	self->empty_pos = self->empty + cells;
+	self->empty_len = cells;
+
+	for (size_t i = 0; i < cells; i++)
+		self->empty[i] = self->empty_pos[i] = i;
+
+	if (!(self->journal = malloc(cells * BOARD_UNDO_PER_MOVE * sizeof *self->journal))) {
+		free(self->empty);
+		free(self->segments);
+		return false;
+	}
+
+	if (!(self->frames = malloc(cells * sizeof *self->frames))) {
+		free(self->journal);
+		free(self->empty);
+		free(self->segments);
+		return false;
+	}
+
+	if (!(self->codes = malloc(cells * (sizeof *self->codes + sizeof *self->inferior)))) {
+		free(self->frames);
+		free(self->journal);
+		free(self->empty);
+		free(self->segments);
+		return false;
+	}
+
+	self->inferior = (u8 *) (self->codes + cells);
+
+	self->journal_len = self->frames_len = 0;
+
 	for (size_t i = 0; i < segments; i++) {
 		struct segment *segment = &self->segments[i];
 
@@ -91,6 +339,9 @@ board_init(struct board *self, u32 size)
 	black_source->occupant = black_sink->occupant = CELL_BLACK;
 	white_source->occupant = white_sink->occupant = CELL_WHITE;
 
+	pattern_init();
+	board_patterns_reset(self);
+
 	return true;
 }
 
@@ -100,6 +351,10 @@ board_free(struct board *self)
 	assert(self);
 
 	free(self->segments);
+	free(self->empty);
+	free(self->journal);
+	free(self->frames);
+	free(self->codes);
 }
 
 void
@@ -109,19 +364,67 @@ board_copy(struct board const *restrict self, struct board *restrict other)
 	assert(other);
 
 	assert(self->size == other->size);
+	assert(!self->frames_len);
 
 	size_t segments = (self->size * self->size) + _BOARD_EDGE_COUNT;
 	memcpy(other->segments, self->segments, segments * sizeof *self->segments);
+
+	other->hash = self->hash;
+
+	size_t cells = self->size * self->size;
+	memcpy(other->empty, self->empty, 2 * cells * sizeof *self->empty);
+	other->empty_len = self->empty_len;
+
+	memcpy(other->codes, self->codes, cells * (sizeof *self->codes + sizeof *self->inferior));
 }
 
-bool
-board_play(struct board *self, enum hex_player player, u32 x, u32 y)
+static void
+board_record(struct board *self, struct segment *segment)
+{
+	struct board_undo *undo = &self->journal[self->journal_len++];
+
+	undo->segment = segment - self->segments;
+	undo->parent = segment->parent;
+	undo->rank = segment->rank;
+}
+
+static void
+board_merge(struct board *self, struct segment *segment, struct segment *elem)
 {
 	assert(self);
 
-	struct segment *segment = &self->segments[y * self->size + x];
+	if (!self->frames_len) {
+		segment_merge(segment, elem);
+		return;
+	}
+
+	/* as segment_merge, but recording both roots before they change, and
+	 * without compressing paths (which would change segments we never
+	 * recorded)
+	 */
+	struct segment *segment_root = segment_find(segment);
+	struct segment *elem_root = segment_find(elem);
+
+	if (segment_root == elem_root) return;
+
+	board_record(self, segment_root);
+	board_record(self, elem_root);
+
+	if (segment_root->rank <= elem_root->rank) {
+		segment_root->parent = segment_abs2rel(segment_root, elem_root);
+	} else {
+		elem_root->parent = segment_abs2rel(elem_root, segment_root);
+	}
+
+	if (segment_root->rank == elem_root->rank) elem_root->rank++;
+}
+
+static void
+board_place(struct board *self, enum hex_player player, u32 x, u32 y)
+{
+	assert(self);
 
-	if (segment->occupant != CELL_EMPTY) return false;
+	struct segment *segment = &self->segments[y * self->size + x];
 
 	segment->occupant = (enum cell) player;
 
@@ -129,14 +432,14 @@ board_play(struct board *self, enum hex_player player, u32 x, u32 y)
 	 */
 	if (player == HEX_PLAYER_BLACK) {
 		if (x == 0)
-			segment_merge(board_black_source(self), segment);
+			board_merge(self, board_black_source(self), segment);
 		else if (x == self->size - 1)
-			segment_merge(board_black_sink(self), segment);
+			board_merge(self, board_black_sink(self), segment);
 	} else if (player == HEX_PLAYER_WHITE) {
 		if (y == 0)
-			segment_merge(board_white_source(self), segment);
+			board_merge(self, board_white_source(self), segment);
 		else if (y == self->size - 1)
-			segment_merge(board_white_sink(self), segment);
+			board_merge(self, board_white_sink(self), segment);
 	}
 
 	/* handle connecting to neighbouring segments with same occupant
@@ -149,37 +452,130 @@ board_play(struct board *self, enum hex_player player, u32 x, u32 y)
 			struct segment *neighbour = &self->segments[py * self->size + px];
 
 			if (segment->occupant == neighbour->occupant)
-				segment_merge(segment, neighbour);
+				board_merge(self, segment, neighbour);
 		}
 	}
+}
+
+static void
+board_empty_remove(struct board *self, u32 idx)
+{
+	assert(self);
+	assert(self->empty_len);
+
+	u16 pos = self->empty_pos[idx];
+	u16 last = self->empty[--self->empty_len];
+
+	self->empty[pos] = last;
+	self->empty_pos[last] = pos;
+
+	self->empty[self->empty_len] = idx;
+	self->empty_pos[idx] = self->empty_len;
+}
+
+bool
+board_play(struct board *self, enum hex_player player, u32 x, u32 y)
+{
+	assert(self);
+	assert(!self->frames_len);
+
+	u32 idx = y * self->size + x;
+
+	if (self->segments[idx].occupant != CELL_EMPTY) return false;
+
+	board_empty_remove(self, idx);
+
+	self->hash ^= zobrist_cell(player, idx);
+
+	board_place(self, player, x, y);
+
+	board_patterns_update(self, player, x, y);
+
+	return true;
+}
+
+bool
+board_make(struct board *self, enum hex_player player, u32 x, u32 y)
+{
+	assert(self);
+
+	u32 idx = y * self->size + x;
+
+	if (self->segments[idx].occupant != CELL_EMPTY) return false;
+
+	struct board_frame *frame = &self->frames[self->frames_len++];
+	frame->journal_len = self->journal_len;
+	frame->cell = idx;
+	frame->player = player;
+
+	board_empty_remove(self, idx);
+
+	self->hash ^= zobrist_cell(player, idx);
+
+	board_place(self, player, x, y);
 
 	return true;
 }
 
 void
-board_swap(struct board *self)
+board_unmake(struct board *self)
 {
 	assert(self);
+	assert(self->frames_len);
+
+	struct board_frame *frame = &self->frames[--self->frames_len];
+
+	while (self->journal_len > frame->journal_len) {
+		struct board_undo *undo = &self->journal[--self->journal_len];
+		struct segment *segment = &self->segments[undo->segment];
 
-	for (u32 j = 0; j < self->size; j++) {
-		for (u32 i = 0; i < self->size; i++) {
-			struct segment *segment = &self->segments[j * self->size + i];
+		segment->parent = undo->parent;
+		segment->rank = undo->rank;
+	}
+
+	self->segments[frame->cell].occupant = CELL_EMPTY;
+
+	/* removing a cell from the empty cell array leaves it just past the
+	 * end of the array, so growing the array restores it
+	 */
+	assert(self->empty[self->empty_len] == frame->cell);
+	self->empty_len++;
 
-			switch (segment->occupant) {
-			case CELL_BLACK:
-				segment->occupant = CELL_EMPTY;
-				board_play(self, HEX_PLAYER_WHITE, i, j);
-				break;
+	self->hash ^= zobrist_cell(frame->player, frame->cell);
+}
 
-			case CELL_WHITE:
-				segment->occupant = CELL_EMPTY;
-				board_play(self, HEX_PLAYER_BLACK, i, j);
-				break;
+void
+board_swap(struct board *self)
+{
+	assert(self);
+	assert(!self->frames_len);
 
-			default: break;
-			}
+	/* the empty cells are unchanged by a swap, and the occupied cells are
+	 * exactly those past the end of the empty cell array
+	 */
+	size_t cells = self->size * self->size;
+	for (size_t k = self->empty_len; k < cells; k++) {
+		u32 idx = self->empty[k], i = idx % self->size, j = idx / self->size;
+		struct segment *segment = &self->segments[idx];
+
+		switch (segment->occupant) {
+		case CELL_BLACK:
+			segment->occupant = CELL_EMPTY;
+			self->hash ^= zobrist_cell(HEX_PLAYER_BLACK, idx) ^ zobrist_cell(HEX_PLAYER_WHITE, idx);
+			board_place(self, HEX_PLAYER_WHITE, i, j);
+			break;
+
+		case CELL_WHITE:
+			segment->occupant = CELL_EMPTY;
+			self->hash ^= zobrist_cell(HEX_PLAYER_WHITE, idx) ^ zobrist_cell(HEX_PLAYER_BLACK, idx);
+			board_place(self, HEX_PLAYER_BLACK, i, j);
+			break;
+
+		default: break;
 		}
 	}
+
+	board_patterns_reset(self);
 }
 
 size_t
@@ -187,21 +583,14 @@ board_available_moves(struct board const *self, struct move *buf)
 {
 	assert(self);
 
-	size_t idx = 0;
-	for (u32 j = 0; j < self->size; j++) {
-		for (u32 i = 0; i < self->size; i++) {
-			if (self->segments[j * self->size + i].occupant == CELL_EMPTY) {
-				if (buf) {
-					buf[idx].x = i;
-					buf[idx].y = j;
-				}
-
-				idx++;
-			}
+	if (buf) {
+		for (size_t i = 0; i < self->empty_len; i++) {
+			buf[i].x = self->empty[i] % self->size;
+			buf[i].y = self->empty[i] / self->size;
 		}
 	}
 
-	return idx;
+	return self->empty_len;
 }
 
 bool
@@ -209,13 +598,55 @@ board_winner(struct board *self, enum hex_player *out)
 {
 	assert(self);
 
-	if (segment_root(board_black_source(self)) == segment_root(board_black_sink(self))) {
+	/* paths may only be compressed while no journaled move is outstanding */
+	struct segment *(*root)(struct segment *) = self->frames_len ? segment_find : segment_root;
+
+	if (root(board_black_source(self)) == root(board_black_sink(self))) {
 		*out = HEX_PLAYER_BLACK;
 		return true;
-	} else if (segment_root(board_white_source(self)) == segment_root(board_white_sink(self))) {
+	} else if (root(board_white_source(self)) == root(board_white_sink(self))) {
 		*out = HEX_PLAYER_WHITE;
 		return true;
 	}
 
 	return false;
 }
+
+bool
+board_completes(struct board *self, enum hex_player player, u32 x, u32 y)
+{
+	assert(self);
+
+	struct segment *(*root)(struct segment *) = self->frames_len ? segment_find : segment_root;
+
+	struct segment *source, *sink;
+	u32 pos;
+
+	if (player == HEX_PLAYER_BLACK) {
+		source = root(board_black_source(self));
+		sink = root(board_black_sink(self));
+		pos = x;
+	} else {
+		source = root(board_white_source(self));
+		sink = root(board_white_sink(self));
+		pos = y;
+	}
+
+	bool to_source = pos == 0, to_sink = pos == self->size - 1;
+
+	for (size_t i = 0; i < NEIGHBOUR_COUNT; i++) {
+		s64 px = x + neighbour_dx[i];
+		s64 py = y + neighbour_dy[i];
+
+		if (0 <= px && px < self->size && 0 <= py && py < self->size) {
+			struct segment *neighbour = &self->segments[py * self->size + px];
+			if (neighbour->occupant != (enum cell) player) continue;
+
+			struct segment *neighbour_root = root(neighbour);
+			to_source |= neighbour_root == source;
+			to_sink |= neighbour_root == sink;
+		}
+	}
+
+	return to_source && to_sink;
+}
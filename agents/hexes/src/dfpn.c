@@ -0,0 +1,303 @@
+#include "hexes/dfpn.h"
+
+#include "hexes/timeman.h"
+
+bool
+dfpn_init(struct dfpn *self, u32 size, size_t capacity)
+{
+	assert(self);
+
+	if (!board_init(&self->board, size)) return false;
+
+	/* the moves of the current path (and their numbers) never exceed one
+	 * list per empty cell, each no longer than the board
+	 */
+	size_t cells = size * size;
+	size_t stack = cells * (cells * (sizeof(u16) + 2 * sizeof(u32)) + 3 * alignof(u32));
+
+	size_t align = alignof(struct dfpn_bucket);
+	capacity &= ~(align - 1);
+
+	size_t buckets = 1;
+	while ((buckets * 2) * sizeof *self->buckets + stack < capacity) buckets *= 2;
+
+	if (buckets * sizeof *self->buckets + stack >= capacity) goto error_board;
+
+	if (!mem_pool_init(&self->pool, align, capacity)) goto error_board;
+
+	/* fresh pages read as zero, and so as empty entries */
+	if (!(self->buckets = mem_pool_alloc(&self->pool, align, buckets * sizeof *self->buckets)))
+		goto error_pool;
+
+	self->mask = buckets - 1;
+
+	return true;
+
+error_pool:
+	mem_pool_free(&self->pool);
+error_board:
+	board_free(&self->board);
+
+	return false;
+}
+
+void
+dfpn_free(struct dfpn *self)
+{
+	assert(self);
+
+	mem_pool_free(&self->pool);
+	board_free(&self->board);
+}
+
+static inline u64
+dfpn_key(u64 hash, enum hex_player to_move)
+{
+	return hash ^ zobrist_turn(hexopponent(to_move));
+}
+
+static inline bool
+dfpn_lookup(struct dfpn const *self, u64 key, u32 *pn, u32 *dn)
+{
+	struct dfpn_bucket const *bucket = &self->buckets[key & self->mask];
+	u32 check = (u32) (key >> 32);
+
+	for (size_t i = 0; i < DFPN_BUCKET_ENTRIES; i++) {
+		struct dfpn_entry const *entry = &bucket->entries[i];
+
+		if (entry->work && entry->check == check) {
+			*pn = entry->pn;
+			*dn = entry->dn;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static void
+dfpn_store(struct dfpn *self, u64 key, u32 pn, u32 dn, size_t work)
+{
+	struct dfpn_bucket *bucket = &self->buckets[key & self->mask];
+	u32 check = (u32) (key >> 32);
+
+	/* an entry for the same position is updated in place, and otherwise
+	 * the entry with the least work below it is replaced (with empty
+	 * entries having none)
+	 */
+	struct dfpn_entry *victim = &bucket->entries[0];
+	for (size_t i = 0; i < DFPN_BUCKET_ENTRIES; i++) {
+		struct dfpn_entry *entry = &bucket->entries[i];
+
+		if (entry->work && entry->check == check) {
+			victim = entry;
+			break;
+		}
+
+		if (entry->work < victim->work) victim = entry;
+	}
+
+	victim->check = check;
+	victim->pn = pn;
+	victim->dn = dn;
+	victim->work = work < UINT32_MAX ? (u32) work : UINT32_MAX;
+}
+
+static inline u32
+dfpn_add(u32 lhs, u32 rhs)
+{
+	/* an infinite number only ever marks a proven node */
+	u64 sum = (u64) lhs + rhs;
+	return sum < DFPN_INF ? (u32) sum : DFPN_INF - 1;
+}
+
+static inline bool
+dfpn_wins(struct board *board, enum hex_player player, u16 cell)
+{
+	return board_completes(board, player, cell % board->size, cell / board->size);
+}
+
+/* collects the moves worth searching from the current position. a move that
+ * connects our edges wins outright, and a cell that would connect the
+ * opponent's edges must be taken by our move (with two or more such cells,
+ * the position is lost). returns false if the position was settled this way
+ */
+static bool
+dfpn_generate(struct dfpn *self, enum hex_player player, u16 *cells, u32 *len,
+	      u32 *out_pn, u32 *out_dn, u16 *out_best)
+{
+	struct board *board = &self->board;
+
+	/* making and unmaking moves reorders the empty cells */
+	u32 empty_len = board->empty_len;
+	memcpy(cells, board->empty, empty_len * sizeof *cells);
+
+	u32 threats = 0;
+	u16 threat = 0;
+	for (u32 i = 0; i < empty_len; i++) {
+		if (dfpn_wins(board, player, cells[i])) {
+			*out_pn = 0;
+			*out_dn = DFPN_INF;
+			*out_best = cells[i];
+			return false;
+		}
+
+		if (dfpn_wins(board, hexopponent(player), cells[i])) {
+			threats++;
+			threat = cells[i];
+		}
+	}
+
+	if (threats > 1) {
+		*out_pn = DFPN_INF;
+		*out_dn = 0;
+		return false;
+	}
+
+	if (threats) {
+		cells[0] = threat;
+		*len = 1;
+		return true;
+	}
+
+	/* the board only classifies the inferior cells of the position it was
+	 * copied from (making moves leaves them untouched), so dead, captured
+	 * and dominated cells are skipped at the root alone. should every cell
+	 * be inferior, all of them are kept
+	 */
+	u32 kept = empty_len;
+	if (!board->frames_len) {
+		kept = 0;
+		for (u32 i = 0; i < empty_len; i++) {
+			if (!(board->inferior[cells[i]] & (INFERIOR_FILLIN | INFERIOR_DOMINATED(player))))
+				cells[kept++] = cells[i];
+		}
+	}
+
+	*len = kept ? kept : empty_len;
+
+	return true;
+}
+
+static void
+dfpn_mid(struct dfpn *self, enum hex_player player, u32 th_pn, u32 th_dn, u32 *out_pn, u32 *out_dn)
+{
+	struct board *board = &self->board;
+	enum hex_player opponent = hexopponent(player);
+
+	u64 key = dfpn_key(board->hash, player);
+	size_t start_nodes = self->nodes++;
+
+	if (self->nodes % DFPN_POLL_NODES == 0
+	    && (self->nodes >= self->max_nodes || timeman_now() >= self->deadline))
+		self->aborted = true;
+
+	/* the numbers of every child are read from the table once, and then
+	 * only those of the child searched are updated (a transposition
+	 * updating another child in the meantime is only ever picked up on
+	 * the next visit)
+	 */
+	size_t pool_len = self->pool.len;
+	size_t empty_len = board->empty_len;
+
+	u16 *cells = mem_pool_alloc(&self->pool, alignof(u16), empty_len * sizeof *cells);
+	u32 *child_pn = mem_pool_alloc(&self->pool, alignof(u32), empty_len * sizeof *child_pn);
+	u32 *child_dn = mem_pool_alloc(&self->pool, alignof(u32), empty_len * sizeof *child_dn);
+	assert(cells && child_pn && child_dn);
+
+	u32 pn, dn, len;
+	u16 best = 0;
+
+	if (!dfpn_generate(self, player, cells, &len, &pn, &dn, &best)) goto store;
+
+	for (u32 i = 0; i < len; i++) {
+		u64 child_key = dfpn_key(board->hash ^ zobrist_cell(player, cells[i]), opponent);
+
+		child_pn[i] = child_dn[i] = 1;
+		dfpn_lookup(self, child_key, &child_pn[i], &child_dn[i]);
+	}
+
+	while (true) {
+		/* we win if any move leaves the opponent lost, and lose only if
+		 * every move leaves the opponent won
+		 */
+		u32 best_idx = 0, best_dn = DFPN_INF, second_dn = DFPN_INF;
+		dn = 0;
+
+		for (u32 i = 0; i < len; i++) {
+			dn = dfpn_add(dn, child_pn[i]);
+
+			if (child_dn[i] < best_dn) {
+				second_dn = best_dn;
+				best_dn = child_dn[i];
+				best_idx = i;
+			} else if (child_dn[i] < second_dn) {
+				second_dn = child_dn[i];
+			}
+		}
+
+		/* sums saturate below infinity, so that only a proof makes the
+		 * disproof number infinite
+		 */
+		pn = best_dn;
+		if (pn == 0) dn = DFPN_INF;
+
+		best = cells[best_idx];
+
+		if (pn >= th_pn || dn >= th_dn || self->aborted) break;
+
+		u32 child_th_pn = th_dn == DFPN_INF ? DFPN_INF : dfpn_add(th_dn - dn, child_pn[best_idx]);
+
+		u32 child_th_dn = th_pn;
+		if (second_dn != DFPN_INF) {
+			u64 bound = (u64) second_dn + (second_dn >> DFPN_EPSILON_SHIFT) + 1;
+			if (bound < child_th_dn) child_th_dn = (u32) bound;
+		}
+
+		board_make(board, player, best % board->size, best / board->size);
+		dfpn_mid(self, opponent, child_th_pn, child_th_dn, &child_pn[best_idx], &child_dn[best_idx]);
+		board_unmake(board);
+	}
+
+store:
+	self->pool.len = pool_len;
+
+	dfpn_store(self, key, pn, dn, self->nodes - start_nodes);
+
+	if (!board->frames_len) self->best = best;
+
+	*out_pn = pn;
+	*out_dn = dn;
+}
+
+enum dfpn_result
+dfpn_solve(struct dfpn *self, struct board const *board, enum hex_player player,
+	   u64 deadline, size_t max_nodes, u32 *out_x, u32 *out_y)
+{
+	assert(self);
+	assert(board);
+	assert(out_x);
+	assert(out_y);
+
+	board_copy(board, &self->board);
+
+	enum hex_player winner;
+	if (board_winner(&self->board, &winner))
+		return winner == player ? DFPN_WIN : DFPN_LOSS;
+
+	self->deadline = deadline;
+	self->nodes = 0;
+	self->max_nodes = max_nodes;
+	self->aborted = false;
+
+	u32 pn, dn;
+	dfpn_mid(self, player, DFPN_INF, DFPN_INF, &pn, &dn);
+
+	if (pn == 0) {
+		*out_x = self->best % self->board.size;
+		*out_y = self->best / self->board.size;
+		return DFPN_WIN;
+	}
+
+	return dn == 0 ? DFPN_LOSS : DFPN_UNKNOWN;
+}
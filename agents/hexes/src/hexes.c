@@ -1,13 +1,21 @@
 #include "hexes.h"
 #include "hexes/agent.h"
+#include "hexes/bench.h"
 #include "hexes/board.h"
 #include "hexes/log.h"
+#include "hexes/memory.h"
 #include "hexes/network.h"
+#include "hexes/playout.h"
+#include "hexes/rng.h"
+#include "hexes/selftest.h"
 #include "hexes/threadpool.h"
+#include "hexes/timeman.h"
 
 struct opts opts = {
 	.log_level = LOG_INFO,
 	.agent_type = AGENT_RANDOM,
+	.playout_policy = PLAYOUT_POLICY_BRIDGE,
+	.prefault = false,
 	.host = NULL,
 	.port = NULL,
 };
@@ -15,6 +23,9 @@ struct opts opts = {
 static bool
 argparse(int argc, char **argv, struct opts *opts);
 
+static bool
+log_sink_fits(void);
+
 enum game_state {
 	GAME_START,
 	GAME_RECV,
@@ -29,7 +40,11 @@ struct game {
 	struct agent agent;
 
 	size_t round, thread_limit, mem_limit_mib;
-	struct timespec timer;
+
+	/* the game time left to us, and the moment our clock on the server
+	 * last started running (when the message before our move arrived)
+	 */
+	struct timespec timer, turn_start;
 	enum hex_player player, opponent;
 
 	enum game_state state;
@@ -55,12 +70,32 @@ end_handler(struct game *game);
 int
 main(int argc, char **argv)
 {
-	srandom(getpid());
+	rng_seed(((u64) getpid() << 32) ^ (u64) time(NULL));
+
+	/* the benchmark runs the search offline, without a server */
+	if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+		opts.agent_type = AGENT_MCTS;
+		opts.log_level = LOG_WARN;
+
+		exit(bench_run(argc - 1, argv + 1) ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
+	/* the self-test checks the solvers against an exhaustive search */
+	if (argc > 1 && strcmp(argv[1], "selftest") == 0) {
+		opts.log_level = LOG_WARN;
+
+		exit(selftest_run(argc - 1, argv + 1) ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
 
 	if (!argparse(argc, argv, &opts)) exit(EXIT_FAILURE);
 
-	dbglog(LOG_DEBUG, "Opts: log_level: %" PRIu32 ", agent_type: %" PRIu32 ", host: %s, port: %s\n",
-			opts.log_level, opts.agent_type, opts.host, opts.port);
+	if (!log_sink_fits())
+		dbglog(LOG_INFO, "Thread limit leaves no room for the log sink, logging synchronously\n");
+	else if (!log_init())
+		dbglog(LOG_WARN, "Failed to start log sink, logging synchronously\n");
+
+	dbglog(LOG_DEBUG, "Opts: log_level: %" PRIu32 ", agent_type: %" PRIu32 ", playout_policy: %" PRIu32 ", host: %s, port: %s\n",
+			opts.log_level, opts.agent_type, opts.playout_policy, opts.host, opts.port);
 
 	if (!network_init(&game.network, opts.host, opts.port)) {
 		dbglog(LOG_ERROR, "Failed to initialise network (connecting to %s:%s)\n", opts.host, opts.port);
@@ -89,12 +124,28 @@ main(int argc, char **argv)
 	exit(EXIT_SUCCESS);
 }
 
+/* every thread counts against RLIMIT_NPROC, and the log sink is the least
+ * useful of them, so it only starts should the limit leave room for the main
+ * thread and the search's pondering (and prefaulting) threads besides
+ */
+static bool
+log_sink_fits(void)
+{
+	struct rlimit rlimit;
+	if (getrlimit(RLIMIT_NPROC, &rlimit) || rlimit.rlim_cur == RLIM_INFINITY) return true;
+
+	rlim_t threads = 1;
+	if (opts.agent_type == AGENT_MCTS) threads += opts.prefault ? 2 : 1;
+
+	return rlimit.rlim_cur > threads;
+}
+
 static bool
 argparse(int argc, char **argv, struct opts *opts)
 {
 	assert(opts);
 
-	char const *optstr = "va:";
+	char const *optstr = "vpa:P:";
 
 	int opt;
 	while ((opt = getopt(argc, argv, optstr)) != -1) {
@@ -103,6 +154,10 @@ argparse(int argc, char **argv, struct opts *opts)
 			opts->log_level = LOG_DEBUG;
 			break;
 
+		case 'p':
+			opts->prefault = true;
+			break;
+
 		case 'a':
 			if (strcmp(optarg, "random") == 0) {
 				opts->agent_type = AGENT_RANDOM;
@@ -114,6 +169,16 @@ argparse(int argc, char **argv, struct opts *opts)
 			}
 			break;
 
+		case 'P': {
+			enum playout_policy policy;
+			if (!playout_policy_parse(optarg, &policy)) {
+				fprintf(stderr, "Unknown playout policy: %s.\n", optarg);
+				goto error;
+			}
+
+			opts->playout_policy = policy;
+		} break;
+
 		default: goto error; /* ? */
 		}
 	}
@@ -126,7 +191,9 @@ argparse(int argc, char **argv, struct opts *opts)
 	return true;
 
 error:
-	fprintf(stderr, "Usage: %s [-v] [-a random|mcts] <host> <port>\n", argv[0]);
+	fprintf(stderr, "Usage: %s [-v] [-p] [-a random|mcts] [-P random|bridge] <host> <port>\n", argv[0]);
+	fprintf(stderr, "       %s bench [-r rounds | -t millis] [-s seed] [-m mem-mib] [-P random|bridge]\n", argv[0]);
+	fprintf(stderr, "       %s selftest [-s seed] [dfpn|pattern|hsearch]...\n", argv[0]);
 
 	return false;
 }
@@ -144,14 +211,16 @@ start_handler(struct game *game)
 		goto error;
 	}
 
+	clock_gettime(CLOCK_MONOTONIC, &game->turn_start);
+
 	game->player = msg.data.start.player;
 	game->opponent = hexopponent(game->player);
 	game->timer.tv_sec = msg.data.start.game_secs;
 	game->thread_limit = msg.data.start.thread_limit;
 	game->mem_limit_mib = msg.data.start.mem_limit_mib;
 
-	dbglog(LOG_INFO, "Received game parameters: player: %s, board size: %" PRIu32 ", game secs: %" PRIu32 ", thread limit: %" PRIu32 ", mem limit (MiB): %" PRIu32 "\n",
-			hexplayerstr(game->player), msg.data.start.board_size, game->timer.tv_sec, game->thread_limit, game->mem_limit_mib);
+	dbglog(LOG_INFO, "Received game parameters: player: %s, board size: %" PRIu32 ", game secs: %" PRIu32 ", thread limit: %zu, mem limit (MiB): %zu\n",
+			hexplayerstr(game->player), msg.data.start.board_size, msg.data.start.game_secs, game->thread_limit, game->mem_limit_mib);
 
 	if (!threadpool_init(&game->threadpool, msg.data.start.thread_limit - 1)) {
 		dbglog(LOG_ERROR, "Failed to initialise threadpool\n");
@@ -187,8 +256,22 @@ recv_handler(struct game *game)
 
 	enum hex_msg_type expected[] = { HEX_MSG_MOVE, HEX_MSG_SWAP, HEX_MSG_END, };
 
+	/* we keep searching while the opponent thinks, so that the part of the
+	 * tree below their reply is already grown once it arrives
+	 */
+	agent_ponder_start(&game->agent);
+
 	struct hex_msg msg;
-	if (!network_recv(&game->network, &msg, expected, ARRLEN(expected))) {
+	bool received = network_recv(&game->network, &msg, expected, ARRLEN(expected));
+
+	/* our clock runs from here, so stopping the ponder thread and playing
+	 * the opponent's move is charged to us as well
+	 */
+	clock_gettime(CLOCK_MONOTONIC, &game->turn_start);
+
+	agent_ponder_stop(&game->agent);
+
+	if (!received) {
 		dbglog(LOG_ERROR, "Failed to receive message from server\n");
 		goto error;
 	}
@@ -244,37 +327,47 @@ send_handler(struct game *game)
 		.type = HEX_MSG_MOVE,
 	};
 
-	size_t total_rounds = (game->board.size * game->board.size) / 2;
+	size_t total_cells = game->board.size * game->board.size;
+	size_t empty_cells = board_available_moves(&game->board, NULL);
+
+	/* the time already spent since our clock started is not ours to give
+	 * to the search
+	 */
+	struct timespec now, elapsed, remaining;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	difftimespec(&now, &game->turn_start, &elapsed);
+	difftimespec(&game->timer, &elapsed, &remaining);
 
-	struct timespec timeout = {
-		.tv_sec = game->timer.tv_sec / (total_rounds - game->round),
-	}, start, end, diff, new_timer;
+	struct timeman_budget budget = timeman_allocate(&remaining, empty_cells, total_cells);
 
-	clock_gettime(CLOCK_MONOTONIC, &start);
-	if (!agent_next(&game->agent, timeout, &msg.data.move.board_x, &msg.data.move.board_y)) {
+	if (!agent_next(&game->agent, &budget, &msg.data.move.board_x, &msg.data.move.board_y)) {
 		dbglog(LOG_ERROR, "Failed to generate next move\n");
 		goto error;
 	}
-	clock_gettime(CLOCK_MONOTONIC, &end);
-
-	difftimespec(&end, &start, &diff);
-	difftimespec(&game->timer, &diff, &new_timer);
-	game->timer = new_timer;
 
 	dbglog(LOG_INFO, "Generated move: {x=%" PRIu32 ", y=%" PRIu32 "}\n", msg.data.move.board_x, msg.data.move.board_y);
 
-	if (!board_play(&game->board, game->player, msg.data.move.board_x, msg.data.move.board_y)) {
-		dbglog(LOG_ERROR, "Failed to play generated move on board\n");
+	if (!network_send(&game->network, &msg)) {
+		dbglog(LOG_ERROR, "Failed to send message to server\n");
 		goto error;
 	}
 
-	agent_play(&game->agent, game->player, msg.data.move.board_x, msg.data.move.board_y);
+	/* our clock stops once the move is sent, so the bookkeeping for our
+	 * own move runs on the opponent's time
+	 */
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	difftimespec(&now, &game->turn_start, &elapsed);
+	difftimespec(&game->timer, &elapsed, &remaining);
+	game->timer = remaining;
 
-	if (!network_send(&game->network, &msg)) {
-		dbglog(LOG_ERROR, "Failed to send message to server\n");
+	if (!board_play(&game->board, game->player, msg.data.move.board_x, msg.data.move.board_y)) {
+		dbglog(LOG_ERROR, "Failed to play generated move on board\n");
 		goto error;
 	}
 
+	agent_play(&game->agent, game->player, msg.data.move.board_x, msg.data.move.board_y);
+
 	game->state = GAME_RECV;
 
 	return;
@@ -0,0 +1,612 @@
+#include "hexes/hsearch.h"
+
+#include "hexes/timeman.h"
+#include "hexes/utils.h"
+
+extern inline hsearch_set_t
+hsearch_bit(u32 idx);
+
+extern inline u32
+hsearch_source(struct hsearch const *self);
+
+extern inline u32
+hsearch_sink(struct hsearch const *self);
+
+extern inline bool
+hsearch_supported(u32 size);
+
+static inline struct hsearch_vcs *
+hsearch_pair(struct hsearch const *self, u32 lhs, u32 rhs)
+{
+	if (lhs > rhs) SWAP(lhs, rhs);
+
+	/* pairs are stored as the upper triangle of the node matrix */
+	size_t row = (size_t) lhs * (2 * self->nodes - lhs - 1) / 2;
+
+	return &self->vcs[row + (rhs - lhs - 1)];
+}
+
+static inline u32
+hsearch_count(hsearch_set_t set)
+{
+	return __builtin_popcountll((u64) set) + __builtin_popcountll((u64) (set >> 64));
+}
+
+static inline u32
+hsearch_first(hsearch_set_t set)
+{
+	u64 lo = (u64) set;
+
+	return lo ? (u32) __builtin_ctzll(lo) : 64 + (u32) __builtin_ctzll((u64) (set >> 64));
+}
+
+static inline bool
+hsearch_subset(hsearch_set_t lhs, hsearch_set_t rhs)
+{
+	return !(lhs & ~rhs);
+}
+
+/* endpoints are tested against carriers, which only hold cells */
+static inline hsearch_set_t
+hsearch_node_bit(struct hsearch const *self, u32 node)
+{
+	return node < self->cells ? hsearch_bit(node) : 0;
+}
+
+static inline bool
+hsearch_is_stone(struct hsearch const *self, u32 node)
+{
+	return node >= self->cells || (self->own & hsearch_bit(node));
+}
+
+static void
+hsearch_enqueue(struct hsearch *self, u32 lhs, u32 rhs, hsearch_set_t carrier)
+{
+	if (self->queue_len == HSEARCH_QUEUE_CAP) return;
+
+	u32 idx = (self->queue_head + self->queue_len++) % HSEARCH_QUEUE_CAP;
+
+	self->queue[idx].carrier = carrier;
+	self->queue[idx].lhs = lhs;
+	self->queue[idx].rhs = rhs;
+}
+
+static void
+hsearch_remove_full(struct hsearch *self, u32 lhs, u32 rhs, struct hsearch_vcs *vcs, size_t idx)
+{
+	vcs->full[idx] = vcs->full[--vcs->full_len];
+
+	if (!vcs->full_len) {
+		self->linked[lhs] &= ~hsearch_bit(rhs);
+		self->linked[rhs] &= ~hsearch_bit(lhs);
+	}
+}
+
+static void
+hsearch_remove_semi(struct hsearch_vcs *vcs, size_t idx)
+{
+	size_t last = --vcs->semi_len;
+
+	vcs->semi[idx] = vcs->semi[last];
+	vcs->semi_key[idx] = vcs->semi_key[last];
+}
+
+static bool
+hsearch_add_full(struct hsearch *self, u32 lhs, u32 rhs, hsearch_set_t carrier)
+{
+	if (lhs == rhs) return false;
+
+	struct hsearch_vcs *vcs = hsearch_pair(self, lhs, rhs);
+
+	/* a carrier is only worth keeping if no smaller one is known, and it
+	 * makes every larger full and semi vc redundant
+	 */
+	for (size_t i = 0; i < vcs->full_len; i++) {
+		if (hsearch_subset(vcs->full[i], carrier)) return false;
+	}
+
+	for (size_t i = 0; i < vcs->full_len; /* nop */) {
+		if (hsearch_subset(carrier, vcs->full[i])) {
+			vcs->full[i] = vcs->full[--vcs->full_len];
+		} else {
+			i++;
+		}
+	}
+
+	for (size_t i = 0; i < vcs->semi_len; /* nop */) {
+		if (hsearch_subset(carrier, vcs->semi[i])) {
+			hsearch_remove_semi(vcs, i);
+		} else {
+			i++;
+		}
+	}
+
+	if (vcs->full_len == HSEARCH_MAX_FULL) {
+		size_t largest = 0;
+		for (size_t i = 1; i < vcs->full_len; i++) {
+			if (hsearch_count(vcs->full[i]) > hsearch_count(vcs->full[largest])) largest = i;
+		}
+
+		if (hsearch_count(carrier) >= hsearch_count(vcs->full[largest])) return false;
+
+		vcs->full[largest] = carrier;
+	} else {
+		vcs->full[vcs->full_len++] = carrier;
+	}
+
+	self->linked[lhs] |= hsearch_bit(rhs);
+	self->linked[rhs] |= hsearch_bit(lhs);
+
+	hsearch_enqueue(self, lhs, rhs, carrier);
+
+	return true;
+}
+
+/* the or rule: semi vcs whose carriers have no cell in common combine into
+ * a full vc, as the opponent cannot intrude into all of them at once
+ */
+static bool
+hsearch_or(struct hsearch *self, u32 lhs, u32 rhs, struct hsearch_vcs *vcs,
+	   hsearch_set_t intersection, hsearch_set_t carrier, size_t start, u32 depth)
+{
+	for (size_t i = start; i < vcs->semi_len; i++) {
+		hsearch_set_t next = intersection & vcs->semi[i];
+		if (next == intersection) continue;
+
+		if (!next) return hsearch_add_full(self, lhs, rhs, carrier | vcs->semi[i]);
+
+		if (depth > 1 && hsearch_or(self, lhs, rhs, vcs, next, carrier | vcs->semi[i], i + 1, depth - 1))
+			return true;
+	}
+
+	return false;
+}
+
+static void
+hsearch_add_semi(struct hsearch *self, u32 lhs, u32 rhs, hsearch_set_t carrier, u32 key)
+{
+	if (lhs == rhs) return;
+
+	struct hsearch_vcs *vcs = hsearch_pair(self, lhs, rhs);
+
+	for (size_t i = 0; i < vcs->full_len; i++) {
+		if (hsearch_subset(vcs->full[i], carrier)) return;
+	}
+
+	for (size_t i = 0; i < vcs->semi_len; i++) {
+		if (hsearch_subset(vcs->semi[i], carrier)) return;
+	}
+
+	for (size_t i = 0; i < vcs->semi_len; /* nop */) {
+		if (hsearch_subset(carrier, vcs->semi[i])) {
+			hsearch_remove_semi(vcs, i);
+		} else {
+			i++;
+		}
+	}
+
+	size_t idx = vcs->semi_len;
+	if (idx == HSEARCH_MAX_SEMI) {
+		idx = 0;
+		for (size_t i = 1; i < vcs->semi_len; i++) {
+			if (hsearch_count(vcs->semi[i]) > hsearch_count(vcs->semi[idx])) idx = i;
+		}
+
+		if (hsearch_count(carrier) >= hsearch_count(vcs->semi[idx])) return;
+	} else {
+		vcs->semi_len++;
+	}
+
+	vcs->semi[idx] = carrier;
+	vcs->semi_key[idx] = key;
+
+	hsearch_or(self, lhs, rhs, vcs, carrier, carrier, 0, HSEARCH_OR_DEPTH);
+}
+
+/* the and rule: a new full vc is combined with every full vc sharing one of
+ * its endpoints, as long as neither carrier touches the other vc. through
+ * a stone (or an edge) the result is a full vc, and through an empty cell
+ * it is a semi vc keyed at that cell
+ */
+static void
+hsearch_and(struct hsearch *self, u32 mid, u32 end, hsearch_set_t carrier)
+{
+	hsearch_set_t end_bit = hsearch_node_bit(self, end);
+	bool stone = hsearch_is_stone(self, mid);
+
+	hsearch_set_t others = self->linked[mid] & ~hsearch_bit(end) & ~carrier;
+	while (others) {
+		u32 other = hsearch_first(others);
+		others &= others - 1;
+
+		struct hsearch_vcs *vcs = hsearch_pair(self, mid, other);
+		for (size_t i = 0; i < vcs->full_len; i++) {
+			hsearch_set_t rhs = vcs->full[i];
+
+			self->work++;
+			if ((rhs & carrier) || (rhs & end_bit)) continue;
+
+			if (stone) {
+				hsearch_add_full(self, end, other, carrier | rhs);
+			} else {
+				hsearch_add_semi(self, end, other, carrier | rhs | hsearch_bit(mid), mid);
+			}
+
+			/* the pair may have been pruned by what was just added */
+			if (i >= vcs->full_len) break;
+		}
+	}
+}
+
+static void
+hsearch_close(struct hsearch *self, u64 deadline)
+{
+	assert(self);
+
+	self->work = 0;
+
+	u64 poll = HSEARCH_POLL_WORK;
+	while (self->queue_len && self->work < HSEARCH_MAX_WORK) {
+		if (self->work >= poll) {
+			if (deadline != UINT64_MAX && timeman_now() >= deadline) break;
+			poll = self->work + HSEARCH_POLL_WORK;
+		}
+
+		struct hsearch_pending pending = self->queue[self->queue_head];
+		self->queue_head = (self->queue_head + 1) % HSEARCH_QUEUE_CAP;
+		self->queue_len--;
+
+		hsearch_and(self, pending.lhs, pending.rhs, pending.carrier);
+		hsearch_and(self, pending.rhs, pending.lhs, pending.carrier);
+	}
+
+	if (self->queue_len) {
+		dbglog(LOG_DEBUG, "H-search for %s stopped with %" PRIu32 " vcs pending\n",
+				  hexplayerstr(self->player), self->queue_len);
+	}
+
+	self->queue_head = self->queue_len = 0;
+}
+
+static void
+hsearch_reset(struct hsearch *self)
+{
+	size_t pairs = (size_t) self->nodes * (self->nodes - 1) / 2;
+	for (size_t i = 0; i < pairs; i++)
+		self->vcs[i].full_len = self->vcs[i].semi_len = 0;
+
+	memset(self->linked, 0, self->nodes * sizeof *self->linked);
+
+	self->queue_head = self->queue_len = 0;
+}
+
+/* the neighbours of a cell, with the player's edges as extra nodes */
+static size_t
+hsearch_neighbours(struct hsearch const *self, u32 cell, u32 out[8])
+{
+	s32 const dx[6] = { 1, 1, 0, -1, -1, 0, };
+	s32 const dy[6] = { 0, -1, -1, 0, 1, 1, };
+
+	s32 n = (s32) self->size, x = (s32) (cell % self->size), y = (s32) (cell / self->size);
+
+	size_t len = 0;
+	for (size_t i = 0; i < 6; i++) {
+		s32 nx = x + dx[i], ny = y + dy[i];
+		if (nx < 0 || nx >= n || ny < 0 || ny >= n) continue;
+
+		out[len++] = (u32) (ny * n + nx);
+	}
+
+	s32 pos = self->player == HEX_PLAYER_BLACK ? x : y;
+	if (pos == 0) out[len++] = hsearch_source(self);
+	if (pos == n - 1) out[len++] = hsearch_sink(self);
+
+	return len;
+}
+
+static void
+hsearch_link_cell(struct hsearch *self, u32 cell)
+{
+	u32 neighbours[8];
+	size_t len = hsearch_neighbours(self, cell, neighbours);
+
+	for (size_t i = 0; i < len; i++) {
+		u32 other = neighbours[i];
+		if (other < self->cells && (self->other & hsearch_bit(other))) continue;
+
+		hsearch_add_full(self, cell, other, 0);
+	}
+}
+
+bool
+hsearch_init(struct hsearch *self, u32 size, enum hex_player player)
+{
+	assert(self);
+
+	if (!hsearch_supported(size)) return false;
+
+	self->size = size;
+	self->cells = size * size;
+	self->nodes = self->cells + 2;
+	self->player = player;
+	self->own = self->other = 0;
+
+	size_t pairs = (size_t) self->nodes * (self->nodes - 1) / 2;
+
+	if (!(self->vcs = malloc(pairs * sizeof *self->vcs)))
+		return false;
+
+	if (!(self->linked = malloc(self->nodes * sizeof *self->linked))) {
+		free(self->vcs);
+		return false;
+	}
+
+	if (!(self->queue = malloc(HSEARCH_QUEUE_CAP * sizeof *self->queue))) {
+		free(self->linked);
+		free(self->vcs);
+		return false;
+	}
+
+	hsearch_reset(self);
+
+	return true;
+}
+
+void
+hsearch_free(struct hsearch *self)
+{
+	assert(self);
+
+	free(self->queue);
+	free(self->linked);
+	free(self->vcs);
+}
+
+void
+hsearch_load(struct hsearch *self, struct board const *board)
+{
+	assert(self);
+	assert(board);
+	assert(board->size == self->size);
+
+	hsearch_reset(self);
+
+	/* the occupied cells are exactly those past the end of the board's
+	 * empty cell array
+	 */
+	self->own = self->other = 0;
+	for (size_t i = board->empty_len; i < self->cells; i++) {
+		u32 idx = board->empty[i];
+
+		if ((enum hex_player) board->segments[idx].occupant == self->player) {
+			self->own |= hsearch_bit(idx);
+		} else {
+			self->other |= hsearch_bit(idx);
+		}
+	}
+
+	for (u32 cell = 0; cell < self->cells; cell++) {
+		if (!(self->other & hsearch_bit(cell))) hsearch_link_cell(self, cell);
+	}
+
+	hsearch_close(self, UINT64_MAX);
+}
+
+/* an own stone keeps every vc valid, and frees every carrier holding it
+ * from having to hold it. semi vcs keyed at the stone become full vcs, and
+ * the stone now joins the full vcs ending in it into full vcs
+ */
+static void
+hsearch_play_own(struct hsearch *self, u32 cell)
+{
+	hsearch_set_t bit = hsearch_bit(cell);
+
+	self->own |= bit;
+
+	for (u32 lhs = 0; lhs < self->nodes; lhs++) {
+		for (u32 rhs = lhs + 1; rhs < self->nodes; rhs++) {
+			struct hsearch_vcs *vcs = hsearch_pair(self, lhs, rhs);
+
+			for (size_t i = 0; i < vcs->full_len; i++) {
+				if (!(vcs->full[i] & bit)) continue;
+
+				vcs->full[i] &= ~bit;
+				hsearch_enqueue(self, lhs, rhs, vcs->full[i]);
+			}
+
+			/* the keyed semis are only turned into full vcs once every
+			 * semi of the pair is freed of the stone, as adding a full
+			 * vc can prune (and so reorder) the remaining semis
+			 */
+			hsearch_set_t keyed[HSEARCH_MAX_SEMI];
+			size_t keyed_len = 0;
+
+			for (size_t i = 0; i < vcs->semi_len; /* nop */) {
+				if (!(vcs->semi[i] & bit)) {
+					i++;
+					continue;
+				}
+
+				if (vcs->semi_key[i] == cell) {
+					keyed[keyed_len++] = vcs->semi[i] & ~bit;
+					hsearch_remove_semi(vcs, i);
+				} else {
+					vcs->semi[i++] &= ~bit;
+				}
+			}
+
+			for (size_t i = 0; i < keyed_len; i++)
+				hsearch_add_full(self, lhs, rhs, keyed[i]);
+		}
+	}
+
+	hsearch_set_t others = self->linked[cell];
+	while (others) {
+		u32 other = hsearch_first(others);
+		others &= others - 1;
+
+		struct hsearch_vcs *vcs = hsearch_pair(self, cell, other);
+		for (size_t i = 0; i < vcs->full_len; i++)
+			hsearch_enqueue(self, cell, other, vcs->full[i]);
+	}
+}
+
+/* an opponent stone breaks every vc ending in it or needing it, and every
+ * other vc stays valid. the vcs around the stone are combined afresh, to
+ * recover connections that were crowded out by the broken ones
+ */
+static void
+hsearch_play_other(struct hsearch *self, u32 cell)
+{
+	hsearch_set_t bit = hsearch_bit(cell);
+
+	self->other |= bit;
+
+	hsearch_set_t linked = self->linked[cell];
+	while (linked) {
+		u32 other = hsearch_first(linked);
+		linked &= linked - 1;
+
+		self->linked[other] &= ~bit;
+	}
+
+	self->linked[cell] = 0;
+
+	for (u32 lhs = 0; lhs < self->nodes; lhs++) {
+		for (u32 rhs = lhs + 1; rhs < self->nodes; rhs++) {
+			struct hsearch_vcs *vcs = hsearch_pair(self, lhs, rhs);
+
+			if (lhs == cell || rhs == cell) {
+				vcs->full_len = vcs->semi_len = 0;
+				continue;
+			}
+
+			for (size_t i = 0; i < vcs->full_len; /* nop */) {
+				if (vcs->full[i] & bit) {
+					hsearch_remove_full(self, lhs, rhs, vcs, i);
+				} else {
+					i++;
+				}
+			}
+
+			for (size_t i = 0; i < vcs->semi_len; /* nop */) {
+				if (vcs->semi[i] & bit) {
+					hsearch_remove_semi(vcs, i);
+				} else {
+					i++;
+				}
+			}
+		}
+	}
+
+	u32 neighbours[8];
+	size_t len = hsearch_neighbours(self, cell, neighbours);
+
+	for (size_t n = 0; n < len; n++) {
+		u32 node = neighbours[n];
+		if (node < self->cells && (self->other & hsearch_bit(node))) continue;
+
+		hsearch_set_t others = self->linked[node];
+		while (others) {
+			u32 other = hsearch_first(others);
+			others &= others - 1;
+
+			struct hsearch_vcs *vcs = hsearch_pair(self, node, other);
+			for (size_t i = 0; i < vcs->full_len; i++)
+				hsearch_enqueue(self, node, other, vcs->full[i]);
+		}
+	}
+}
+
+void
+hsearch_play(struct hsearch *self, enum hex_player player, u32 x, u32 y, u64 deadline)
+{
+	assert(self);
+	assert(x < self->size);
+	assert(y < self->size);
+
+	u32 cell = y * self->size + x;
+	assert(!((self->own | self->other) & hsearch_bit(cell)));
+
+	if (player == self->player) {
+		hsearch_play_own(self, cell);
+	} else {
+		hsearch_play_other(self, cell);
+	}
+
+	hsearch_close(self, deadline);
+}
+
+bool
+hsearch_connected(struct hsearch const *self)
+{
+	assert(self);
+
+	struct hsearch_vcs const *vcs = hsearch_pair(self, hsearch_source(self), hsearch_sink(self));
+
+	return vcs->full_len;
+}
+
+bool
+hsearch_winning_move(struct hsearch const *self, u32 *out)
+{
+	assert(self);
+	assert(out);
+
+	struct hsearch_vcs const *vcs = hsearch_pair(self, hsearch_source(self), hsearch_sink(self));
+	if (!vcs->semi_len) return false;
+
+	size_t best = 0;
+	for (size_t i = 1; i < vcs->semi_len; i++) {
+		if (hsearch_count(vcs->semi[i]) < hsearch_count(vcs->semi[best])) best = i;
+	}
+
+	*out = vcs->semi_key[best];
+
+	return true;
+}
+
+bool
+hsearch_mustplay(struct hsearch const *self, hsearch_set_t *out)
+{
+	assert(self);
+	assert(out);
+
+	struct hsearch_vcs const *vcs = hsearch_pair(self, hsearch_source(self), hsearch_sink(self));
+	if (!vcs->full_len && !vcs->semi_len) return false;
+
+	hsearch_set_t mustplay = ~(hsearch_set_t) 0;
+	for (size_t i = 0; i < vcs->full_len; i++)
+		mustplay &= vcs->full[i];
+
+	for (size_t i = 0; i < vcs->semi_len; i++)
+		mustplay &= vcs->semi[i];
+
+	*out = mustplay;
+
+	return true;
+}
+
+bool
+hsearch_carriers_empty(struct hsearch const *self)
+{
+	assert(self);
+
+	hsearch_set_t stones = self->own | self->other;
+
+	for (u32 lhs = 0; lhs < self->nodes; lhs++) {
+		for (u32 rhs = lhs + 1; rhs < self->nodes; rhs++) {
+			struct hsearch_vcs const *vcs = hsearch_pair(self, lhs, rhs);
+
+			for (size_t i = 0; i < vcs->full_len; i++) {
+				if (vcs->full[i] & stones) return false;
+			}
+
+			for (size_t i = 0; i < vcs->semi_len; i++) {
+				if ((vcs->semi[i] & stones) || (stones & hsearch_bit(vcs->semi_key[i]))) return false;
+			}
+		}
+	}
+
+	return true;
+}
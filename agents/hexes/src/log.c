@@ -1,4 +1,189 @@
 #include "hexes/log.h"
 
-extern inline void
-dbglog(enum log_level, char const *, ...);
+#include <pthread.h>
+
+extern inline bool
+log_enabled(enum log_level log_level);
+
+/* the sink keeps two buffers: producers append to the active one under the
+ * state lock, while the flusher swaps it out and writes the other one with
+ * only the io lock held. anything writing to stderr takes the io lock, and
+ * always after the state lock, which keeps the output in order
+ */
+static struct log_sink {
+	pthread_mutex_t state_lock, io_lock;
+	pthread_cond_t cond;
+
+	char buf[2][LOG_BUFFER_SIZE];
+	size_t len[2];
+	u32 active;
+
+	pthread_t thread;
+	bool running, stop;
+} sink = {
+	.state_lock = PTHREAD_MUTEX_INITIALIZER,
+	.io_lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+};
+
+static void
+log_sink_write(char const *buf, size_t len)
+{
+	if (!len) return;
+
+	fwrite(buf, 1, len, stderr);
+	fflush(stderr);
+}
+
+/* expects the state lock to be held */
+static void
+log_sink_drain(char const *line, size_t len)
+{
+	pthread_mutex_lock(&sink.io_lock);
+
+	log_sink_write(sink.buf[sink.active], sink.len[sink.active]);
+	sink.len[sink.active] = 0;
+
+	log_sink_write(line, len);
+
+	pthread_mutex_unlock(&sink.io_lock);
+}
+
+static void *
+log_thread(void *arg)
+{
+	(void) arg;
+
+	pthread_mutex_lock(&sink.state_lock);
+
+	while (!sink.stop) {
+		struct timespec deadline;
+		clock_gettime(CLOCK_REALTIME, &deadline);
+
+		u64 nsec = (u64) deadline.tv_nsec + LOG_FLUSH_NANOS;
+		deadline.tv_sec += nsec / 1000000000ULL;
+		deadline.tv_nsec = nsec % 1000000000ULL;
+
+		pthread_cond_timedwait(&sink.cond, &sink.state_lock, &deadline);
+
+		u32 idx = sink.active;
+		if (!sink.len[idx]) continue;
+
+		sink.active ^= 1;
+
+		pthread_mutex_lock(&sink.io_lock);
+		pthread_mutex_unlock(&sink.state_lock);
+
+		log_sink_write(sink.buf[idx], sink.len[idx]);
+		sink.len[idx] = 0;
+
+		pthread_mutex_unlock(&sink.io_lock);
+		pthread_mutex_lock(&sink.state_lock);
+	}
+
+	pthread_mutex_unlock(&sink.state_lock);
+
+	return NULL;
+}
+
+static void
+log_free(void)
+{
+	pthread_mutex_lock(&sink.state_lock);
+	bool running = sink.running;
+	sink.stop = true;
+	pthread_cond_signal(&sink.cond);
+	pthread_mutex_unlock(&sink.state_lock);
+
+	if (running) pthread_join(sink.thread, NULL);
+
+	pthread_mutex_lock(&sink.state_lock);
+	sink.running = false;
+	log_sink_drain(NULL, 0);
+	pthread_mutex_unlock(&sink.state_lock);
+}
+
+bool
+log_init(void)
+{
+	if (atexit(log_free)) return false;
+
+	pthread_attr_t attr;
+	if (pthread_attr_init(&attr)) return false;
+
+	pthread_attr_setstacksize(&attr, LOG_THREAD_STACK);
+
+	/* without a flusher thread every message is written synchronously,
+	 * exactly as before the sink was started
+	 */
+	pthread_mutex_lock(&sink.state_lock);
+	sink.running = pthread_create(&sink.thread, &attr, log_thread, NULL) == 0;
+	pthread_mutex_unlock(&sink.state_lock);
+
+	pthread_attr_destroy(&attr);
+
+	return sink.running;
+}
+
+static void
+log_sink_append(enum log_level log_level, char const *line, size_t len)
+{
+	pthread_mutex_lock(&sink.state_lock);
+
+	u32 idx = sink.active;
+	if (!sink.running || log_level <= LOG_WARN || sink.len[idx] + len > LOG_BUFFER_SIZE) {
+		log_sink_drain(line, len);
+	} else {
+		memcpy(sink.buf[idx] + sink.len[idx], line, len);
+		sink.len[idx] += len;
+
+		if (sink.len[idx] >= LOG_BUFFER_SIZE / 2) pthread_cond_signal(&sink.cond);
+	}
+
+	pthread_mutex_unlock(&sink.state_lock);
+}
+
+void
+log_flush(void)
+{
+	pthread_mutex_lock(&sink.state_lock);
+	log_sink_drain(NULL, 0);
+	pthread_mutex_unlock(&sink.state_lock);
+}
+
+void
+log_write(enum log_level log_level, char const *fmt, ...)
+{
+	char line[LOG_LINE_MAX];
+	char const *prefix = "";
+
+	switch (log_level) {
+	case LOG_ERROR:	prefix = "[ERROR]"; break;
+	case LOG_WARN:	prefix = "[WARN] "; break;
+	case LOG_INFO:	prefix = "[INFO] "; break;
+	case LOG_DEBUG:	prefix = "[DEBUG]"; break;
+	}
+
+	int len = snprintf(line, sizeof line, "%s ", prefix);
+
+	va_list ap;
+	va_start(ap, fmt);
+	int res = vsnprintf(line + len, sizeof line - len, fmt, ap);
+	va_end(ap);
+
+	if (res < 0) return;
+
+	/* overlong messages are truncated to a single line */
+	size_t total = (size_t) len + (size_t) res;
+	if (total >= sizeof line) total = sizeof line - 1;
+
+	log_sink_append(log_level, line, total);
+}
+
+void
+log_record(char const *line, size_t len)
+{
+	assert(line);
+
+	log_sink_append(LOG_INFO, line, len);
+}
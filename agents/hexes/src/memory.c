@@ -0,0 +1,43 @@
+#include "hexes/memory.h"
+
+bool
+memory_usage(struct memory_usage *out)
+{
+	assert(out);
+
+	FILE *statm = fopen("/proc/self/statm", "r");
+	if (!statm) return false;
+
+	/* size resident shared text lib data dt, all in pages */
+	size_t size, resident, shared, text, lib, data;
+	int fields = fscanf(statm, "%zu %zu %zu %zu %zu %zu", &size, &resident, &shared, &text, &lib, &data);
+
+	fclose(statm);
+
+	if (fields != 6) return false;
+
+	size_t page_size = sysconf(_SC_PAGESIZE);
+
+	out->data = data * page_size;
+	out->resident = resident * page_size;
+
+	return true;
+}
+
+size_t
+memory_available(size_t advertised)
+{
+	size_t limit = advertised;
+
+	struct rlimit rlimit;
+	if (getrlimit(RLIMIT_DATA, &rlimit) == 0 && rlimit.rlim_cur != RLIM_INFINITY && rlimit.rlim_cur < limit)
+		limit = rlimit.rlim_cur;
+
+	struct memory_usage usage;
+	if (!memory_usage(&usage)) {
+		dbglog(LOG_WARN, "Failed to read memory usage, assuming none\n");
+		return limit;
+	}
+
+	return limit > usage.data ? limit - usage.data : 0;
+}
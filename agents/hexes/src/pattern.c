@@ -0,0 +1,99 @@
+#include "hexes/pattern.h"
+
+struct pattern_tables pattern_tables;
+
+s8 const pattern_dx[PATTERN_NEIGHBOURS] = { +1, +1, 0, -1, -1, 0, };
+s8 const pattern_dy[PATTERN_NEIGHBOURS] = { 0, -1, -1, 0, +1, +1, };
+
+extern inline enum pattern_state
+pattern_stone(enum hex_player player);
+
+extern inline u32
+pattern_opposite(u32 dir);
+
+extern inline enum pattern_state
+pattern_get(pattern_code_t code, u32 dir);
+
+extern inline pattern_code_t
+pattern_set(pattern_code_t code, u32 dir, enum pattern_state state);
+
+extern inline enum pattern_state
+pattern_edge(u32 size, s64 x, s64 y);
+
+extern inline bool
+pattern_dead(pattern_code_t code);
+
+extern inline u8
+pattern_bridge(pattern_code_t code, enum hex_player player);
+
+/* the number of separate chains formed by a set of neighbours */
+static u32
+pattern_chains(u32 set)
+{
+	u32 full = (1 << PATTERN_NEIGHBOURS) - 1;
+	if (set == full) return 1;
+
+	/* every chain starts at a neighbour whose predecessor is not in it */
+	u32 rotated = ((set << 1) | (set >> (PATTERN_NEIGHBOURS - 1))) & full;
+	return __builtin_popcount(set & ~rotated);
+}
+
+/* whether a stone of the player on the cell never joins anything, however
+ * the empty neighbours are filled
+ */
+static bool
+pattern_irrelevant(pattern_code_t code, enum pattern_state stone)
+{
+	u32 own = 0, empty = 0;
+	for (u32 i = 0; i < PATTERN_NEIGHBOURS; i++) {
+		enum pattern_state state = pattern_get(code, i);
+
+		if (state == stone) own |= 1 << i;
+		else if (state == PATTERN_EMPTY) empty |= 1 << i;
+	}
+
+	/* we walk every subset of the empty neighbours, as the ones the player
+	 * ends up owning
+	 */
+	u32 filled = 0;
+	do {
+		if (pattern_chains(own | filled) > 1) return false;
+
+		filled = (filled - empty) & empty;
+	} while (filled);
+
+	return true;
+}
+
+static u8
+pattern_carriers(pattern_code_t code, enum pattern_state stone)
+{
+	u8 carriers = 0;
+	for (u32 i = 0; i < PATTERN_NEIGHBOURS; i++) {
+		u32 prev = (i + PATTERN_NEIGHBOURS - 1) % PATTERN_NEIGHBOURS;
+		u32 next = (i + 1) % PATTERN_NEIGHBOURS;
+
+		if (pattern_get(code, i) == PATTERN_EMPTY
+		    && pattern_get(code, prev) == stone && pattern_get(code, next) == stone)
+			carriers |= 1 << i;
+	}
+
+	return carriers;
+}
+
+void
+pattern_init(void)
+{
+	static bool initialised = false;
+	if (initialised) return;
+
+	for (u32 code = 0; code < PATTERN_CODES; code++) {
+		pattern_tables.dead[code] = pattern_irrelevant(code, PATTERN_BLACK)
+					 && pattern_irrelevant(code, PATTERN_WHITE);
+
+		pattern_tables.bridge[HEX_PLAYER_BLACK][code] = pattern_carriers(code, PATTERN_BLACK);
+		pattern_tables.bridge[HEX_PLAYER_WHITE][code] = pattern_carriers(code, PATTERN_WHITE);
+	}
+
+	initialised = true;
+}
@@ -0,0 +1,136 @@
+#include "hexes/playout.h"
+
+#include "hexes/utils.h"
+
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "Batched playouts read narrow bitboards as 64-bit words, assuming a little-endian target"
+#endif
+
+extern inline playout_mask_t
+playout_batch_lanes(struct playout_batch const *self);
+
+extern inline playout_mask_t
+playout_batch_wins(struct playout_batch const *self, enum hex_player player);
+
+static inline bool
+playout_lanes_any(playout_lanes_t const *lanes)
+{
+	u64 acc = 0;
+	for (size_t l = 0; l < PLAYOUT_LANES; l++)
+		acc |= (*lanes)[l];
+
+	return acc;
+}
+
+static void
+playout_record_owner(u32 lane, u32 word, u64 bits, playout_mask_t *owned)
+{
+	while (bits) {
+		u32 cell = word * BITSET_WORD_BITS + __builtin_ctzll(bits);
+		bits &= bits - 1;
+
+		owned[cell] |= (playout_mask_t) (1u << lane);
+	}
+}
+
+/* the generic kernel, followed by the kernels for the common board sizes */
+#define PLAYOUT_KERNEL_SIZE 0
+#define PLAYOUT_KERNEL_SUFFIX generic
+#include "playout_kernel.h"
+
+#define PLAYOUT_KERNEL_SIZE 9
+#define PLAYOUT_KERNEL_SUFFIX 9
+#include "playout_kernel.h"
+
+#define PLAYOUT_KERNEL_SIZE 11
+#define PLAYOUT_KERNEL_SUFFIX 11
+#include "playout_kernel.h"
+
+#define PLAYOUT_KERNEL_SIZE 13
+#define PLAYOUT_KERNEL_SUFFIX 13
+#include "playout_kernel.h"
+
+#define PLAYOUT_KERNEL_SIZE 19
+#define PLAYOUT_KERNEL_SUFFIX 19
+#include "playout_kernel.h"
+
+bool
+playout_policy_parse(char const *str, enum playout_policy *out)
+{
+	assert(str);
+	assert(out);
+
+	if (strcmp(str, "random") == 0) {
+		*out = PLAYOUT_POLICY_RANDOM;
+	} else if (strcmp(str, "bridge") == 0) {
+		*out = PLAYOUT_POLICY_BRIDGE;
+	} else {
+		return false;
+	}
+
+	return true;
+}
+
+char const *
+playout_policy_str(enum playout_policy policy)
+{
+	switch (policy) {
+	case PLAYOUT_POLICY_RANDOM:	return "random";
+	case PLAYOUT_POLICY_BRIDGE:	return "bridge";
+	default:			return "unknown";
+	}
+}
+
+playout_batch_fn
+playout_batch_kernel(u32 size, enum playout_policy policy)
+{
+	if (policy == PLAYOUT_POLICY_BRIDGE) {
+		switch (size) {
+		case 9:		return playout_batch_bridge_9;
+		case 11:	return playout_batch_bridge_11;
+		case 13:	return playout_batch_bridge_13;
+		case 19:	return playout_batch_bridge_19;
+		default:	return playout_batch_bridge_generic;
+		}
+	}
+
+	switch (size) {
+	case 9:		return playout_batch_9;
+	case 11:	return playout_batch_11;
+	case 13:	return playout_batch_13;
+	case 19:	return playout_batch_19;
+	default:	return playout_batch_generic;
+	}
+}
+
+void
+playout_batch_terminal(struct bitboard const *board, enum hex_player winner, struct playout_batch *out)
+{
+	assert(board);
+	assert(out);
+
+	struct bitboard_geometry const *geometry = board->geometry;
+
+	/* a decided position yields the same result in every lane, so that it
+	 * carries the same weight as a batch of playouts
+	 */
+	out->lanes = PLAYOUT_LANES;
+
+	playout_mask_t lanes = playout_batch_lanes(out);
+	out->black_wins = winner == HEX_PLAYER_BLACK ? lanes : 0;
+
+	for (size_t p = 0; p < 2; p++) {
+		memset(out->owned[p], 0, geometry->cells * sizeof(playout_mask_t));
+
+		for (u32 i = 0; i < geometry->words; i++) {
+			u64 bits = board->stones[p].wide.words[i];
+
+			while (bits) {
+				u32 cell = i * BITSET_WORD_BITS + __builtin_ctzll(bits);
+				bits &= bits - 1;
+
+				out->owned[p][cell] = lanes;
+			}
+		}
+	}
+}
@@ -0,0 +1,272 @@
+/* a batched playout kernel, included once per specialised board size with
+ * PLAYOUT_KERNEL_SIZE set to that size (or to 0 for the generic kernel,
+ * which reads its dimensions from the geometry) and PLAYOUT_KERNEL_SUFFIX
+ * set to the suffix of the generated function names. with the dimensions
+ * known at compile time, every word loop is fully unrolled and every shift
+ * is by an immediate. the column masks of the geometry act as the sentinel
+ * border that stops the flood from wrapping between rows
+ */
+
+#ifndef PLAYOUT_KERNEL_SIZE
+#error "PLAYOUT_KERNEL_SIZE must be defined before including the playout kernel"
+#endif
+
+#define PLAYOUT_KERNEL_CAT_(name, suffix) name##_##suffix
+#define PLAYOUT_KERNEL_CAT(name, suffix) PLAYOUT_KERNEL_CAT_(name, suffix)
+#define PLAYOUT_KERNEL(name) PLAYOUT_KERNEL_CAT(name, PLAYOUT_KERNEL_SUFFIX)
+
+#if PLAYOUT_KERNEL_SIZE
+_Static_assert(PLAYOUT_KERNEL_SIZE <= BITBOARD_MAX_SIZE, "Specialised board size exceeds the bitboard size");
+
+#define KERNEL_SIZE(geometry) ((u32) PLAYOUT_KERNEL_SIZE)
+#define KERNEL_CELLS(geometry) ((u32) (PLAYOUT_KERNEL_SIZE * PLAYOUT_KERNEL_SIZE))
+#define KERNEL_WORDS(geometry) ((u32) ((PLAYOUT_KERNEL_SIZE * PLAYOUT_KERNEL_SIZE + BITSET_WORD_BITS - 1) / BITSET_WORD_BITS))
+#else
+#define KERNEL_SIZE(geometry) ((geometry)->size)
+#define KERNEL_CELLS(geometry) ((geometry)->cells)
+#define KERNEL_WORDS(geometry) ((geometry)->words)
+#endif
+
+static inline void
+PLAYOUT_KERNEL(playout_neighbours)(struct bitboard_geometry const *geometry, playout_lanes_t const *set, playout_lanes_t *out)
+{
+	u32 const n = KERNEL_SIZE(geometry), words = KERNEL_WORDS(geometry);
+
+	playout_lanes_t l[BITSET_WORDS], r[BITSET_WORDS];
+	for (u32 i = 0; i < words; i++) {
+		l[i] = set[i] & geometry->not_first_col.wide.words[i];
+		r[i] = set[i] & geometry->not_last_col.wide.words[i];
+	}
+
+	/* identical to the wide bitboard neighbourhood, with every lane shifted
+	 * independently by the same amount
+	 */
+	playout_lanes_t const zero = {0};
+
+#define SHL(s, i, k) (((s)[i] << (k)) | ((i) ? (s)[(i) - 1] >> (BITSET_WORD_BITS - (k)) : zero))
+#define SHR(s, i, k) (((s)[i] >> (k)) | ((i) + 1 < words ? (s)[(i) + 1] << (BITSET_WORD_BITS - (k)) : zero))
+
+	for (u32 i = 0; i < words; i++) {
+		out[i] = (SHR(l, i, 1) | SHL(r, i, 1) |
+			  SHR(set, i, n) | SHL(set, i, n) |
+			  SHL(l, i, n - 1) | SHR(r, i, n - 1)) & geometry->mask.wide.words[i];
+	}
+
+#undef SHR
+#undef SHL
+}
+
+/* every lane gets its own shuffle of the remaining moves, of which every
+ * other move goes to the player to move (as in a single playout), so black
+ * owns either the even or the odd moves of each shuffle
+ */
+static void
+PLAYOUT_KERNEL(playout_assign_random)(u32 size, enum hex_player player,
+				      struct move *moves, size_t len, u32 const *draws, playout_lanes_t *black)
+{
+	size_t draws_len = len > 1 ? len - 1 : 0;
+	size_t first = player == HEX_PLAYER_BLACK ? 0 : 1;
+	for (u32 l = 0; l < PLAYOUT_LANES; l++) {
+		SHUFFLE_DRAWS(moves, len, &draws[l * draws_len]);
+
+		for (size_t i = first; i < len; i += 2) {
+			u32 idx = moves[i].y * size + moves[i].x;
+			black[idx / BITSET_WORD_BITS][l] |= (u64) 1 << (idx % BITSET_WORD_BITS);
+		}
+	}
+}
+
+/* as above, except that the moves of every lane are played in order, and a
+ * move into a carrier of an opponent bridge is answered at once with the
+ * other carrier. a reply can intrude into a bridge in turn, and is answered
+ * in the same way
+ */
+static void
+PLAYOUT_KERNEL(playout_assign_bridge)(struct bitboard const *board, enum hex_player player,
+				      struct move *moves, size_t len, u32 const *draws, playout_lanes_t *black)
+{
+	struct bitboard_geometry const *geometry = board->geometry;
+	u32 const size = KERNEL_SIZE(geometry), cells = KERNEL_CELLS(geometry), words = KERNEL_WORDS(geometry);
+
+	/* the state of every cell when the playout starts, followed by one
+	 * entry per state for the neighbours off the board (and padded to
+	 * whole words). cells that are empty but not among the moves (e.g.
+	 * dead cells) read as walls, so that they are never taken as a reply
+	 */
+	u32 const padded = words * BITSET_WORD_BITS > cells + PATTERN_WALL + 1
+			 ? words * BITSET_WORD_BITS : cells + PATTERN_WALL + 1;
+
+	u8 start[BITSET_WORDS * BITSET_WORD_BITS + BITSET_WORD_BITS];
+	memset(start, PATTERN_WALL, padded);
+
+	for (size_t p = 0; p < 2; p++) {
+		for (u32 i = 0; i < words; i++) {
+			u64 bits = board->stones[p].wide.words[i];
+
+			while (bits) {
+				start[i * BITSET_WORD_BITS + __builtin_ctzll(bits)] = pattern_stone((enum hex_player) p);
+				bits &= bits - 1;
+			}
+		}
+	}
+
+	for (size_t i = 0; i < len; i++)
+		start[moves[i].y * size + moves[i].x] = PATTERN_EMPTY;
+
+	for (u32 i = PATTERN_EMPTY; i <= PATTERN_WALL; i++)
+		start[cells + i] = (u8) i;
+
+	u8 state[BITSET_WORDS * BITSET_WORD_BITS + BITSET_WORD_BITS];
+
+	size_t draws_len = len > 1 ? len - 1 : 0;
+	for (u32 l = 0; l < PLAYOUT_LANES; l++) {
+		SHUFFLE_DRAWS(moves, len, &draws[l * draws_len]);
+
+		memcpy(state, start, padded);
+
+		/* a cell taken earlier as a reply is skipped when its turn in
+		 * the shuffle comes
+		 */
+		enum hex_player mover = player;
+		for (size_t i = 0; i < len; i++) {
+			u16 idx = (u16) (moves[i].y * size + moves[i].x);
+			if (state[idx] != PATTERN_EMPTY) continue;
+
+			/* every reply fills a cell, so the replies always end */
+			while (true) {
+				state[idx] = pattern_stone(mover);
+				mover = hexopponent(mover);
+
+				u16 const *ring = geometry->ring[idx];
+
+				pattern_code_t code = 0;
+				for (u32 d = 0; d < PATTERN_NEIGHBOURS; d++)
+					code |= (pattern_code_t) (state[ring[d]] << (2 * d));
+
+				u8 carriers = pattern_bridge(code, mover);
+				if (!carriers) break;
+
+				idx = ring[__builtin_ctz(carriers)];
+			}
+		}
+
+		/* the black stones of the lane are gathered a word at a time */
+		for (u32 i = 0; i < words; i++) {
+			u64 bits = 0;
+			for (u32 b = 0; b < BITSET_WORD_BITS; b++)
+				bits |= (u64) (state[i * BITSET_WORD_BITS + b] == PATTERN_BLACK) << b;
+
+			black[i][l] = bits & geometry->mask.wide.words[i];
+		}
+	}
+}
+
+static void
+PLAYOUT_KERNEL(playout_finish)(struct bitboard const *board, playout_lanes_t *black, struct playout_batch *out)
+{
+	struct bitboard_geometry const *geometry = board->geometry;
+	u32 const words = KERNEL_WORDS(geometry), cells = KERNEL_CELLS(geometry);
+
+	out->lanes = PLAYOUT_LANES;
+
+	/* flood fill black in every lane at once, until no lane changes */
+	playout_lanes_t reach[BITSET_WORDS], neighbours[BITSET_WORDS];
+	for (u32 i = 0; i < words; i++) {
+		reach[i] = black[i] & (board->reach[HEX_PLAYER_BLACK].wide.words[i]
+				       | geometry->edges[BLACK_SOURCE].wide.words[i]);
+	}
+
+	bool changed;
+	do {
+		PLAYOUT_KERNEL(playout_neighbours)(geometry, reach, neighbours);
+
+		playout_lanes_t diff = {0};
+		for (u32 i = 0; i < words; i++) {
+			playout_lanes_t next = reach[i] | (neighbours[i] & black[i]);
+			diff |= next ^ reach[i];
+			reach[i] = next;
+		}
+
+		changed = playout_lanes_any(&diff);
+	} while (changed);
+
+	playout_lanes_t connected = {0};
+	for (u32 i = 0; i < words; i++)
+		connected |= reach[i] & geometry->edges[BLACK_SINK].wide.words[i];
+
+	out->black_wins = 0;
+	for (u32 l = 0; l < PLAYOUT_LANES; l++) {
+		if (connected[l]) out->black_wins |= (playout_mask_t) (1u << l);
+	}
+
+	/* the board is full in every lane, so white owns every cell not owned
+	 * by black
+	 */
+	memset(out->owned[HEX_PLAYER_BLACK], 0, cells * sizeof(playout_mask_t));
+
+	for (u32 l = 0; l < PLAYOUT_LANES; l++) {
+		for (u32 i = 0; i < words; i++)
+			playout_record_owner(l, i, black[i][l], out->owned[HEX_PLAYER_BLACK]);
+	}
+
+	playout_mask_t lanes = playout_batch_lanes(out);
+	for (u32 i = 0; i < cells; i++)
+		out->owned[HEX_PLAYER_WHITE][i] = lanes & ~out->owned[HEX_PLAYER_BLACK][i];
+}
+
+static inline void
+PLAYOUT_KERNEL(playout_run)(struct bitboard const *board, enum hex_player player,
+			    struct move *moves, size_t len, struct playout_batch *out, bool bridge)
+{
+	assert(board);
+	assert(moves);
+	assert(out);
+
+	u32 const words = KERNEL_WORDS(board->geometry), size = KERNEL_SIZE(board->geometry);
+
+	assert(board->geometry->size == size);
+
+	playout_lanes_t black[BITSET_WORDS];
+	for (u32 i = 0; i < words; i++)
+		black[i] = (playout_lanes_t) {0} + board->stones[HEX_PLAYER_BLACK].wide.words[i];
+
+	/* the draws for every shuffle are generated in bulk, several streams
+	 * at a time
+	 */
+	u32 draws[PLAYOUT_LANES * BITBOARD_MAX_SIZE * BITBOARD_MAX_SIZE];
+	size_t draws_len = len > 1 ? len - 1 : 0;
+	rng_fill(draws, PLAYOUT_LANES * draws_len);
+
+	if (bridge) {
+		PLAYOUT_KERNEL(playout_assign_bridge)(board, player, moves, len, draws, black);
+	} else {
+		PLAYOUT_KERNEL(playout_assign_random)(size, player, moves, len, draws, black);
+	}
+
+	PLAYOUT_KERNEL(playout_finish)(board, black, out);
+}
+
+static void
+PLAYOUT_KERNEL(playout_batch)(struct bitboard const *board, enum hex_player player,
+			      struct move *moves, size_t len, struct playout_batch *out)
+{
+	PLAYOUT_KERNEL(playout_run)(board, player, moves, len, out, false);
+}
+
+static void
+PLAYOUT_KERNEL(playout_batch_bridge)(struct bitboard const *board, enum hex_player player,
+				     struct move *moves, size_t len, struct playout_batch *out)
+{
+	PLAYOUT_KERNEL(playout_run)(board, player, moves, len, out, true);
+}
+
+#undef KERNEL_WORDS
+#undef KERNEL_CELLS
+#undef KERNEL_SIZE
+
+#undef PLAYOUT_KERNEL
+#undef PLAYOUT_KERNEL_CAT
+#undef PLAYOUT_KERNEL_CAT_
+
+#undef PLAYOUT_KERNEL_SUFFIX
+#undef PLAYOUT_KERNEL_SIZE
@@ -0,0 +1,83 @@
+#include "hexes/rng.h"
+
+_Thread_local struct rng rng_state;
+
+_Thread_local struct rng_bulk rng_bulk_state;
+
+extern inline u64
+rng_splitmix64(u64 *state);
+
+extern inline u64
+rng_rotl(u64 x, u32 k);
+
+extern inline u64
+rng_next(void);
+
+extern inline u32
+rng_bounded_from(u32 draw, u32 bound);
+
+extern inline u32
+rng_bounded(u32 bound);
+
+void
+rng_seed(u64 seed)
+{
+	/* splitmix64 never yields an all-zero xoshiro state, and gives every
+	 * bulk lane an unrelated stream
+	 */
+	for (size_t i = 0; i < 4; i++)
+		rng_state.s[i] = rng_splitmix64(&seed);
+
+	for (size_t i = 0; i < 4; i++) {
+		for (size_t l = 0; l < RNG_LANES; l++)
+			rng_bulk_state.s[i][l] = rng_splitmix64(&seed);
+	}
+}
+
+/* vectors are passed around by pointer, as passing wide vectors by value
+ * depends on the enabled instruction sets
+ */
+#define RNG_LANES_ROTL(x, k) (((x) << (k)) | ((x) >> (64 - (k))))
+
+static inline void
+rng_lanes_next(struct rng_bulk *self, rng_lanes_t *out)
+{
+	rng_lanes_t *s = self->s;
+
+	*out = RNG_LANES_ROTL(s[1] * 5, 7) * 9;
+	rng_lanes_t t = s[1] << 17;
+
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
+
+	s[2] ^= t;
+	s[3] = RNG_LANES_ROTL(s[3], 45);
+}
+
+void
+rng_fill(u32 *buf, size_t len)
+{
+	assert(buf);
+
+	/* the state is kept in a local so that the compiler can hold it in
+	 * registers for the whole loop
+	 */
+	struct rng_bulk state = rng_bulk_state;
+
+	size_t i = 0;
+	for (; i + 2 * RNG_LANES <= len; i += 2 * RNG_LANES) {
+		rng_lanes_t draws;
+		rng_lanes_next(&state, &draws);
+		memcpy(&buf[i], &draws, sizeof draws);
+	}
+
+	if (i < len) {
+		rng_lanes_t draws;
+		rng_lanes_next(&state, &draws);
+		memcpy(&buf[i], &draws, (len - i) * sizeof *buf);
+	}
+
+	rng_bulk_state = state;
+}
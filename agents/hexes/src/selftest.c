@@ -0,0 +1,606 @@
+#include "hexes/selftest.h"
+
+#include "hexes/dfpn.h"
+#include "hexes/hsearch.h"
+#include "hexes/rng.h"
+#include "hexes/timeman.h"
+#include "hexes/zobrist.h"
+
+struct selftest_entry {
+	u64 key;
+	bool valid, win;
+};
+
+struct selftest_solver {
+	struct selftest_entry *entries;
+	u32 size;
+};
+
+struct selftest_result {
+	size_t positions, checks, failures;
+};
+
+struct selftest_check {
+	char const *name;
+	bool (*run)(struct selftest_solver *solver, struct selftest_result *out);
+};
+
+static void
+selftest_solver_reset(struct selftest_solver *self, u32 size)
+{
+	assert(self);
+
+	/* the zobrist keys of a cell index differ in meaning between sizes */
+	if (self->size != size)
+		memset(self->entries, 0, SELFTEST_SOLVER_ENTRIES * sizeof *self->entries);
+
+	self->size = size;
+}
+
+/* whether the player to move wins, by searching every move to the end of
+ * the game
+ */
+static bool
+selftest_wins(struct selftest_solver *self, struct board *board, enum hex_player player)
+{
+	assert(self);
+	assert(board);
+
+	enum hex_player winner;
+	if (board_winner(board, &winner)) return winner == player;
+
+	u64 key = board->hash ^ zobrist_turn(player);
+	struct selftest_entry *entry = &self->entries[key & (SELFTEST_SOLVER_ENTRIES - 1)];
+	if (entry->valid && entry->key == key) return entry->win;
+
+	/* the moves are copied out, as making and unmaking them reorders the
+	 * board's empty cells
+	 */
+	u16 cells[SELFTEST_MAX_CELLS];
+	u32 len = board->empty_len;
+	memcpy(cells, board->empty, len * sizeof *cells);
+
+	bool win = false;
+	for (u32 i = 0; i < len && !win; i++) {
+		board_make(board, player, cells[i] % board->size, cells[i] / board->size);
+		win = !selftest_wins(self, board, hexopponent(player));
+		board_unmake(board);
+	}
+
+	*entry = (struct selftest_entry) { .key = key, .valid = true, .win = win, };
+
+	return win;
+}
+
+/* plays up to the given number of random stones, alternating from black
+ * and stopping short of any stone that would end the game, and returns the
+ * player to move
+ */
+static enum hex_player
+selftest_random_position(struct board *board, u32 stones)
+{
+	assert(board);
+
+	enum hex_player player = HEX_PLAYER_BLACK;
+	for (u32 i = 0; i < stones && board->empty_len; i++) {
+		u16 cell = board->empty[rng_bounded(board->empty_len)];
+		u32 x = cell % board->size, y = cell / board->size;
+
+		if (board_completes(board, player, x, y)) break;
+
+		board_play(board, player, x, y);
+		player = hexopponent(player);
+	}
+
+	return player;
+}
+
+static void
+selftest_fail(char const *check, struct board const *board, enum hex_player player, char const *fmt, ...)
+{
+	assert(check);
+	assert(board);
+	assert(fmt);
+
+	printf("FAIL %s:", check);
+
+	/* the position is given as the stones of each player, in the usual
+	 * hex notation
+	 */
+	enum hex_player players[] = { HEX_PLAYER_BLACK, HEX_PLAYER_WHITE, };
+	for (size_t i = 0; i < ARRLEN(players); i++) {
+		printf(" %s", hexplayerstr(players[i]));
+
+		for (u32 y = 0; y < board->size; y++) {
+			for (u32 x = 0; x < board->size; x++) {
+				if (board->segments[y * board->size + x].occupant == (enum cell) players[i])
+					printf(" %c%" PRIu32, 'a' + x, y + 1);
+			}
+		}
+	}
+
+	printf(", %s to move: ", hexplayerstr(player));
+
+	va_list ap;
+	va_start(ap, fmt);
+	vprintf(fmt, ap);
+	va_end(ap);
+
+	printf("\n");
+}
+
+/* the endgame solver's result must match the exhaustive search, and the
+ * move it returns for a win must keep the position won
+ */
+static bool
+selftest_dfpn(struct selftest_solver *solver, struct selftest_result *out)
+{
+	assert(solver);
+	assert(out);
+
+	u32 const size = 4;
+
+	static struct dfpn dfpn;
+	if (!dfpn_init(&dfpn, size, SELFTEST_DFPN_MIB * MiB)) return false;
+
+	selftest_solver_reset(solver, size);
+
+	bool res = false;
+
+	for (size_t i = 0; i < SELFTEST_DFPN_POSITIONS; i++) {
+		struct board board;
+		if (!board_init(&board, size)) goto error;
+
+		enum hex_player player = selftest_random_position(&board, 4 + rng_bounded(size * size / 2));
+
+		u32 x, y;
+		enum dfpn_result result = dfpn_solve(&dfpn, &board, player, UINT64_MAX, SIZE_MAX, &x, &y);
+		bool win = selftest_wins(solver, &board, player);
+
+		out->positions++;
+		out->checks++;
+
+		if (result == DFPN_UNKNOWN || (result == DFPN_WIN) != win) {
+			selftest_fail("dfpn", &board, player, "solved as %s, but is %s",
+				      result == DFPN_UNKNOWN ? "unknown" : result == DFPN_WIN ? "won" : "lost",
+				      win ? "won" : "lost");
+			out->failures++;
+		} else if (result == DFPN_WIN) {
+			out->checks++;
+
+			board_make(&board, player, x, y);
+			bool refuted = selftest_wins(solver, &board, hexopponent(player));
+			board_unmake(&board);
+
+			if (refuted) {
+				selftest_fail("dfpn", &board, player, "winning move %c%" PRIu32 " loses", 'a' + x, y + 1);
+				out->failures++;
+			}
+		}
+
+		board_free(&board);
+	}
+
+	res = true;
+
+error:
+	dfpn_free(&dfpn);
+
+	return res;
+}
+
+/* checks the inferior cell flags of a position: they must match the flags
+ * recomputed from scratch, filling in a dead cell for either player or
+ * every captured cell for its captor must not change the position's value,
+ * and a won position must keep a winning move among the cells left after
+ * fill-in and dominance pruning
+ */
+static void
+selftest_pattern_position(struct selftest_solver *solver, struct board *board, enum hex_player player,
+			  struct board *scratch, struct selftest_result *out)
+{
+	assert(solver);
+	assert(board);
+	assert(scratch);
+	assert(out);
+
+	u32 cells = board->size * board->size;
+
+	/* swapping twice restores the stones, but rebuilds every flag */
+	board_copy(board, scratch);
+	board_swap(scratch);
+	board_swap(scratch);
+
+	out->checks++;
+	for (u32 i = 0; i < cells; i++) {
+		if (scratch->codes[i] == board->codes[i] && scratch->inferior[i] == board->inferior[i]) continue;
+
+		selftest_fail("pattern", board, player, "cell %c%" PRIu32 " has flags 0x%" PRIx8 ", recomputed as 0x%" PRIx8,
+			      'a' + i % board->size, i / board->size + 1, board->inferior[i], scratch->inferior[i]);
+		out->failures++;
+		break;
+	}
+
+	bool win = selftest_wins(solver, board, player);
+
+	for (u32 i = 0; i < cells; i++) {
+		u8 flags = board->inferior[i];
+		if (!flags) continue;
+
+		out->checks++;
+
+		if (board->segments[i].occupant != CELL_EMPTY) {
+			selftest_fail("pattern", board, player, "occupied cell %c%" PRIu32 " has flags 0x%" PRIx8,
+				      'a' + i % board->size, i / board->size + 1, flags);
+			out->failures++;
+			continue;
+		}
+
+		if (!(flags & INFERIOR_DEAD)) continue;
+
+		enum hex_player players[] = { HEX_PLAYER_BLACK, HEX_PLAYER_WHITE, };
+		for (size_t j = 0; j < ARRLEN(players); j++) {
+			board_make(board, players[j], i % board->size, i / board->size);
+			bool filled = selftest_wins(solver, board, player);
+			board_unmake(board);
+
+			if (filled != win) {
+				selftest_fail("pattern", board, player, "dead cell %c%" PRIu32 " changes the value for %s",
+					      'a' + i % board->size, i / board->size + 1, hexplayerstr(players[j]));
+				out->failures++;
+			}
+		}
+	}
+
+	u32 filled = 0;
+	for (u32 i = 0; i < cells; i++) {
+		for (enum hex_player captor = HEX_PLAYER_BLACK; captor <= HEX_PLAYER_WHITE; captor++) {
+			if (!(board->inferior[i] & INFERIOR_CAPTURED(captor))) continue;
+
+			board_make(board, captor, i % board->size, i / board->size);
+			filled++;
+			break;
+		}
+	}
+
+	out->checks++;
+
+	enum hex_player winner;
+	bool decided = board_winner(board, &winner);
+	if (selftest_wins(solver, board, player) != win) {
+		selftest_fail("pattern", board, player, "filling in %" PRIu32 " captured cells changes the value", filled);
+		out->failures++;
+	} else if (win && !decided) {
+		out->checks++;
+
+		u16 moves[SELFTEST_MAX_CELLS];
+		u32 len = board->empty_len;
+		memcpy(moves, board->empty, len * sizeof *moves);
+
+		bool found = false;
+		for (u32 i = 0; i < len && !found; i++) {
+			if (board->inferior[moves[i]] & (INFERIOR_FILLIN | INFERIOR_DOMINATED(player))) continue;
+
+			board_make(board, player, moves[i] % board->size, moves[i] / board->size);
+			found = !selftest_wins(solver, board, hexopponent(player));
+			board_unmake(board);
+		}
+
+		if (!found) {
+			selftest_fail("pattern", board, player, "every winning move is pruned");
+			out->failures++;
+		}
+	}
+
+	while (filled--) board_unmake(board);
+}
+
+static bool
+selftest_pattern(struct selftest_solver *solver, struct selftest_result *out)
+{
+	assert(solver);
+	assert(out);
+
+	struct {
+		u32 size, positions, min_stones;
+	} const suites[] = {
+		{ 4, SELFTEST_PATTERN_POSITIONS, SELFTEST_PATTERN_STONES, },
+		{ 5, SELFTEST_PATTERN_LARGE_POSITIONS, SELFTEST_PATTERN_LARGE_STONES, },
+	};
+
+	for (size_t i = 0; i < ARRLEN(suites); i++) {
+		u32 size = suites[i].size, cells = size * size;
+
+		selftest_solver_reset(solver, size);
+
+		struct board scratch;
+		if (!board_init(&scratch, size)) return false;
+
+		for (u32 j = 0; j < suites[i].positions; j++) {
+			u32 min_stones = suites[i].min_stones;
+
+			/* a position cut short by a connecting stone can be left
+			 * with too many empty cells to search, and is redrawn
+			 */
+			struct board board;
+			enum hex_player player;
+			for (;;) {
+				if (!board_init(&board, size)) {
+					board_free(&scratch);
+					return false;
+				}
+
+				player = selftest_random_position(&board, min_stones + rng_bounded(cells - 3 - min_stones));
+				if (board.empty_len <= SELFTEST_MAX_EMPTY) break;
+
+				board_free(&board);
+			}
+
+			/* the flags hold for either player to move */
+			if (rng_bounded(2)) player = hexopponent(player);
+
+			out->positions++;
+			selftest_pattern_position(solver, &board, player, &scratch, out);
+
+			board_free(&board);
+		}
+
+		board_free(&scratch);
+	}
+
+	return true;
+}
+
+/* whether the given player wins the position with the player to move */
+static bool
+selftest_wins_for(struct selftest_solver *solver, struct board *board, enum hex_player player, enum hex_player who)
+{
+	return selftest_wins(solver, board, player) == (player == who);
+}
+
+/* checks the virtual connections between a player's edges: no carrier may
+ * hold a stone, a full vc must win with the opponent to move, the key of a
+ * semi vc must win with the player to move, and every opponent move outside
+ * the must-play set must lose
+ */
+static void
+selftest_hsearch_position(struct selftest_solver *solver, struct board *board, struct hsearch *hsearch,
+			  struct selftest_result *out)
+{
+	assert(solver);
+	assert(board);
+	assert(hsearch);
+	assert(out);
+
+	enum hex_player who = hsearch->player, opponent = hexopponent(who);
+
+	out->checks++;
+
+	if (!hsearch_carriers_empty(hsearch)) {
+		selftest_fail("hsearch", board, opponent, "a carrier of %s holds a stone", hexplayerstr(who));
+		out->failures++;
+	}
+
+	if (hsearch_connected(hsearch)) {
+		out->checks++;
+
+		if (!selftest_wins_for(solver, board, opponent, who)) {
+			selftest_fail("hsearch", board, opponent, "%s has a full vc, but loses", hexplayerstr(who));
+			out->failures++;
+		}
+	}
+
+	u32 key;
+	if (hsearch_winning_move(hsearch, &key)) {
+		out->checks++;
+
+		board_make(board, who, key % board->size, key / board->size);
+		bool won = selftest_wins_for(solver, board, opponent, who);
+		board_unmake(board);
+
+		if (!won) {
+			selftest_fail("hsearch", board, who, "semi vc key %c%" PRIu32 " loses",
+				      'a' + key % board->size, key / board->size + 1);
+			out->failures++;
+		}
+	}
+
+	hsearch_set_t mustplay;
+	if (!hsearch_mustplay(hsearch, &mustplay)) return;
+
+	u16 cells[SELFTEST_MAX_CELLS];
+	u32 len = board->empty_len;
+	memcpy(cells, board->empty, len * sizeof *cells);
+
+	for (u32 i = 0; i < len; i++) {
+		if (mustplay & hsearch_bit(cells[i])) continue;
+
+		out->checks++;
+
+		board_make(board, opponent, cells[i] % board->size, cells[i] / board->size);
+		bool won = selftest_wins_for(solver, board, who, who);
+		board_unmake(board);
+
+		if (!won) {
+			selftest_fail("hsearch", board, opponent, "%c%" PRIu32 " is outside the must-play set, but stops %s",
+				      'a' + cells[i] % board->size, cells[i] / board->size + 1, hexplayerstr(who));
+			out->failures++;
+		}
+	}
+}
+
+static bool
+selftest_hsearch_suite(struct selftest_solver *solver, u32 size, u32 positions, u32 min_stones, u32 span,
+		       struct selftest_result *out)
+{
+	assert(solver);
+	assert(out);
+
+	bool res = false;
+
+	/* the engines are far too large for the stack */
+	static struct hsearch hsearch[2];
+	if (!hsearch_init(&hsearch[HEX_PLAYER_BLACK], size, HEX_PLAYER_BLACK)) return false;
+	if (!hsearch_init(&hsearch[HEX_PLAYER_WHITE], size, HEX_PLAYER_WHITE)) goto error_black;
+
+	selftest_solver_reset(solver, size);
+
+	for (u32 i = 0; i < positions; i++) {
+		struct board board;
+		if (!board_init(&board, size)) goto error_white;
+
+		hsearch_load(&hsearch[HEX_PLAYER_BLACK], &board);
+		hsearch_load(&hsearch[HEX_PLAYER_WHITE], &board);
+
+		/* the moves are played into the engines one at a time, so that
+		 * their incremental updates are checked too
+		 */
+		enum hex_player player = HEX_PLAYER_BLACK;
+		for (u32 stones = min_stones + rng_bounded(span); stones; stones--) {
+			u16 cell = board.empty[rng_bounded(board.empty_len)];
+			u32 x = cell % size, y = cell / size;
+
+			if (board_completes(&board, player, x, y)) break;
+
+			board_play(&board, player, x, y);
+			hsearch_play(&hsearch[HEX_PLAYER_BLACK], player, x, y, UINT64_MAX);
+			hsearch_play(&hsearch[HEX_PLAYER_WHITE], player, x, y, UINT64_MAX);
+
+			player = hexopponent(player);
+		}
+
+		/* a position cut short by a connecting stone is redrawn */
+		if (board.empty_len > SELFTEST_MAX_EMPTY) {
+			board_free(&board);
+			i--;
+			continue;
+		}
+
+		out->positions++;
+		selftest_hsearch_position(solver, &board, &hsearch[HEX_PLAYER_BLACK], out);
+		selftest_hsearch_position(solver, &board, &hsearch[HEX_PLAYER_WHITE], out);
+
+		board_free(&board);
+	}
+
+	res = true;
+
+error_white:
+	hsearch_free(&hsearch[HEX_PLAYER_WHITE]);
+error_black:
+	hsearch_free(&hsearch[HEX_PLAYER_BLACK]);
+
+	return res;
+}
+
+/* the small boards leave room for sparse positions, while the larger ones
+ * are crowded, so that stones land inside many carriers at once
+ */
+static bool
+selftest_hsearch(struct selftest_solver *solver, struct selftest_result *out)
+{
+	assert(solver);
+	assert(out);
+
+	return selftest_hsearch_suite(solver, 4, SELFTEST_HSEARCH_POSITIONS, SELFTEST_HSEARCH_STONES, 4, out)
+	    && selftest_hsearch_suite(solver, 5, SELFTEST_HSEARCH_LARGE_POSITIONS, SELFTEST_HSEARCH_LARGE_STONES,
+				      5 * 5 - 3 - SELFTEST_HSEARCH_LARGE_STONES, out);
+}
+
+static struct selftest_check const selftest_checks[] = {
+	{ "dfpn", selftest_dfpn, },
+	{ "pattern", selftest_pattern, },
+	{ "hsearch", selftest_hsearch, },
+};
+
+static bool
+selftest_selected(struct selftest_check const *check, int argc, char **argv)
+{
+	assert(check);
+
+	/* without any names given, every check runs */
+	if (optind == argc) return true;
+
+	for (int i = optind; i < argc; i++) {
+		if (strcmp(argv[i], check->name) == 0) return true;
+	}
+
+	return false;
+}
+
+bool
+selftest_run(int argc, char **argv)
+{
+	u64 seed = SELFTEST_DEFAULT_SEED;
+
+	char const *optstr = "s:";
+
+	optind = 1;
+
+	int opt;
+	while ((opt = getopt(argc, argv, optstr)) != -1) {
+		switch (opt) {
+		case 's':
+			seed = strtoull(optarg, NULL, 0);
+			break;
+
+		default: goto error;
+		}
+	}
+
+	for (int i = optind; i < argc; i++) {
+		bool known = false;
+		for (size_t j = 0; j < ARRLEN(selftest_checks); j++)
+			known |= strcmp(argv[i], selftest_checks[j].name) == 0;
+
+		if (!known) {
+			fprintf(stderr, "Unknown check: %s.\n", argv[i]);
+			goto error;
+		}
+	}
+
+	struct selftest_solver solver = { .size = 0, };
+	if (!(solver.entries = calloc(SELFTEST_SOLVER_ENTRIES, sizeof *solver.entries))) {
+		dbglog(LOG_ERROR, "Failed to allocate exhaustive solver table\n");
+		return false;
+	}
+
+	printf("selftest: seed 0x%" PRIx64 "\n", seed);
+
+	printf("%-8s %9s %9s %9s %8s\n", "check", "positions", "checks", "failures", "secs");
+
+	bool passed = true;
+	for (size_t i = 0; i < ARRLEN(selftest_checks); i++) {
+		struct selftest_check const *check = &selftest_checks[i];
+		if (!selftest_selected(check, argc, argv)) continue;
+
+		/* every check draws the same positions, whichever others run */
+		rng_seed(seed);
+
+		struct selftest_result result = {0};
+
+		u64 start = timeman_now();
+		if (!check->run(&solver, &result)) {
+			dbglog(LOG_ERROR, "Failed to run check %s\n", check->name);
+			passed = false;
+			continue;
+		}
+
+		double secs = (double) (timeman_now() - start) / NANOSECS;
+
+		printf("%-8s %9zu %9zu %9zu %8.3f\n", check->name, result.positions, result.checks, result.failures, secs);
+
+		if (result.failures) passed = false;
+	}
+
+	free(solver.entries);
+
+	printf("selftest: %s\n", passed ? "passed" : "FAILED");
+
+	return passed;
+
+error:
+	fprintf(stderr, "Usage: hexes selftest [-s seed] [dfpn|pattern|hsearch]...\n");
+
+	return false;
+}
@@ -0,0 +1,77 @@
+#include "hexes/stats.h"
+
+extern inline u64
+stats_cycles(void);
+
+extern inline void
+stats_reset(struct stats *self);
+
+extern inline u64
+stats_phase(struct stats *self, enum stats_phase phase, u64 start);
+
+extern inline void
+stats_round(struct stats *self, u32 depth, bool expanded, u32 playouts, u32 playout_moves);
+
+void
+stats_report(struct stats const *self, char const *label, u64 elapsed_nanos, struct stats_pool const *pool)
+{
+	assert(self);
+	assert(label);
+	assert(pool);
+
+#if HEXES_STATS
+	static char const *phases[_STATS_PHASE_COUNT] = {
+		[STATS_SELECT] = "select",
+		[STATS_EXPAND] = "expand",
+		[STATS_SIMULATE] = "simulate",
+		[STATS_BACKPROP] = "backprop",
+	};
+
+	double secs = elapsed_nanos ? (double) elapsed_nanos / NANOSECS : 0.0;
+	double rate = secs > 0.0 ? 1.0 / secs : 0.0;
+
+	char buf[2 * LOG_LINE_MAX];
+	size_t len = 0;
+
+#define APPEND(...)								\
+	do {									\
+		int res = snprintf(buf + len, sizeof buf - len, __VA_ARGS__);	\
+		if (res > 0) len += (size_t) res;				\
+		if (len >= sizeof buf) len = sizeof buf - 1;			\
+	} while (0)
+
+	APPEND("{\"stats\":\"%s\",\"secs\":%.6f,\"rounds\":%" PRIu64 ",\"nodes\":%" PRIu64 ",\"playouts\":%" PRIu64,
+	       label, secs, self->rounds, self->nodes, self->playouts);
+
+	APPEND(",\"rounds_per_sec\":%.0f,\"nodes_per_sec\":%.0f,\"playouts_per_sec\":%.0f",
+	       (double) self->rounds * rate, (double) self->nodes * rate, (double) self->playouts * rate);
+
+	APPEND(",\"avg_playout_len\":%.2f",
+	       self->playouts ? (double) self->playout_moves / (double) self->playouts : 0.0);
+
+	u64 total = stats_cycles() - self->start;
+	APPEND(",\"cycles\":{\"total\":%" PRIu64, total);
+	for (size_t i = 0; i < _STATS_PHASE_COUNT; i++)
+		APPEND(",\"%s\":%" PRIu64, phases[i], self->cycles[i]);
+	APPEND("}");
+
+	u32 buckets = self->max_depth < STATS_DEPTH_BUCKETS ? self->max_depth + 1 : STATS_DEPTH_BUCKETS;
+	APPEND(",\"max_depth\":%" PRIu32 ",\"depth\":[", self->max_depth);
+	for (u32 i = 0; i < buckets; i++)
+		APPEND("%s%" PRIu64, i ? "," : "", self->depth[i]);
+	APPEND("]");
+
+	APPEND(",\"pool\":{\"used\":%zu,\"free\":%zu,\"committed\":%zu,\"fragmentation\":%.4f}}\n",
+	       pool->used, pool->free, pool->committed,
+	       pool->used ? (double) pool->free / (double) pool->used : 0.0);
+
+#undef APPEND
+
+	log_record(buf, len);
+#else
+	(void) self;
+	(void) label;
+	(void) pool;
+	(void) elapsed_nanos;
+#endif
+}
@@ -0,0 +1,75 @@
+#include "hexes/timeman.h"
+
+extern inline u64
+timeman_now(void);
+
+extern inline bool
+timeman_deadline_poll(struct timeman_deadline *self, u64 *out);
+
+struct timeman_budget
+timeman_allocate(struct timespec const *remaining, size_t empty_cells, size_t total_cells)
+{
+	assert(remaining);
+	assert(total_cells);
+
+	u64 remaining_nanos = TIMESPEC_TO_NANOS(remaining->tv_sec, remaining->tv_nsec);
+	u64 usable = remaining_nanos > TIMEMAN_RESERVE_NANOS ? remaining_nanos - TIMEMAN_RESERVE_NANOS : 0;
+
+	/* we make every other move on the remaining empty cells */
+	size_t moves = (empty_cells + 1) / 2;
+	if (moves < TIMEMAN_MIN_MOVES) moves = TIMEMAN_MIN_MOVES;
+
+	/* the opening is mostly decided by the first few (well-explored)
+	 * moves, and the endgame by a handful of forced moves, so we weight
+	 * the middlegame most heavily, by up to twice the opening's share
+	 */
+	f32 phase = 1.0f - (f32) empty_cells / (f32) total_cells;
+	f32 weight = 0.75f + 3.0f * phase * (1.0f - phase);
+
+	u64 soft = (u64) ((f32) (usable / moves) * weight);
+	u64 hard = soft * TIMEMAN_EXTENSION;
+
+	if (hard > usable / TIMEMAN_HARD_FRACTION) hard = usable / TIMEMAN_HARD_FRACTION;
+	if (soft > hard) soft = hard;
+
+	if (soft < TIMEMAN_MIN_NANOS) soft = TIMEMAN_MIN_NANOS;
+	if (hard < soft) hard = soft;
+
+	return (struct timeman_budget) { .soft = soft, .hard = hard, };
+}
+
+void
+timeman_deadline_init(struct timeman_deadline *self, struct timeman_budget const *budget)
+{
+	assert(self);
+	assert(budget);
+
+	self->start = self->last = timeman_now();
+	self->soft = budget->soft;
+	self->hard = budget->hard;
+
+	self->interval = self->countdown = 1;
+}
+
+u64
+timeman_deadline_read(struct timeman_deadline *self)
+{
+	assert(self);
+
+	u64 now = timeman_now();
+	u64 elapsed = now - self->last;
+
+	/* retune the interval towards the target spacing of polls, growing it
+	 * at most twofold at a time so that a slow start does not overshoot
+	 */
+	if (elapsed < TIMEMAN_POLL_NANOS / 2 && self->interval < UINT32_MAX / 2) {
+		self->interval *= 2;
+	} else if (elapsed > TIMEMAN_POLL_NANOS * 2 && self->interval > 1) {
+		self->interval /= 2;
+	}
+
+	self->countdown = self->interval;
+	self->last = now;
+
+	return now;
+}
@@ -0,0 +1,132 @@
+#include "hexes/ttable.h"
+
+extern inline u64
+ttable_pack_stats(s32 wins, u32 plays);
+
+extern inline void
+ttable_unpack_stats(u64 data, s32 *wins, u32 *plays);
+
+extern inline u8
+ttable_stats_priority(u32 plays);
+
+extern inline size_t
+ttable_size(struct ttable const *self);
+
+bool
+ttable_init(struct ttable *self, size_t capacity)
+{
+	assert(self);
+
+	/* round down to a power-of-two number of buckets, so that the low bits
+	 * of the hash select the bucket
+	 */
+	size_t buckets = 1;
+	while (buckets * 2 * sizeof *self->buckets <= capacity) buckets *= 2;
+
+	if (buckets * sizeof *self->buckets > capacity) return false;
+
+	if (!(self->buckets = aligned_alloc(alignof(struct ttable_bucket), buckets * sizeof *self->buckets)))
+		return false;
+
+	self->mask = buckets - 1;
+
+	ttable_clear(self);
+
+	return true;
+}
+
+void
+ttable_free(struct ttable *self)
+{
+	assert(self);
+
+	free(self->buckets);
+}
+
+void
+ttable_clear(struct ttable *self)
+{
+	assert(self);
+
+	for (size_t i = 0; i <= self->mask; i++) {
+		for (size_t j = 0; j < TTABLE_BUCKET_ENTRIES; j++) {
+			atomic_init(&self->buckets[i].entries[j].check, 0);
+			atomic_init(&self->buckets[i].entries[j].data, 0);
+		}
+	}
+}
+
+static inline bool
+ttable_entry_matches(u64 check, u64 data, u64 hash)
+{
+	return ((check ^ data) & ~TTABLE_PRIORITY_MASK) == (hash & ~TTABLE_PRIORITY_MASK);
+}
+
+bool
+ttable_probe(struct ttable *self, u64 hash, u64 *out)
+{
+	assert(self);
+	assert(out);
+
+	struct ttable_bucket *bucket = &self->buckets[hash & self->mask];
+
+	for (size_t i = 0; i < TTABLE_BUCKET_ENTRIES; i++) {
+		struct ttable_entry *entry = &bucket->entries[i];
+
+		u64 check = atomic_load_explicit(&entry->check, memory_order_relaxed);
+		u64 data = atomic_load_explicit(&entry->data, memory_order_relaxed);
+
+		if (check && ttable_entry_matches(check, data, hash)) {
+			*out = data;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void
+ttable_store(struct ttable *self, u64 hash, u64 data, u8 priority)
+{
+	assert(self);
+
+	struct ttable_bucket *bucket = &self->buckets[hash & self->mask];
+
+	/* overwrite the entry for the same position if there is one, and
+	 * otherwise the entry of lowest priority in the bucket (where empty
+	 * entries have the lowest priority of all)
+	 */
+	struct ttable_entry *victim = NULL;
+	u64 victim_priority = UINT64_MAX;
+
+	for (size_t i = 0; i < TTABLE_BUCKET_ENTRIES; i++) {
+		struct ttable_entry *entry = &bucket->entries[i];
+
+		u64 check = atomic_load_explicit(&entry->check, memory_order_relaxed);
+		u64 old = atomic_load_explicit(&entry->data, memory_order_relaxed);
+
+		if (!check) {
+			if (victim_priority) victim = entry, victim_priority = 0;
+			continue;
+		}
+
+		if (ttable_entry_matches(check, old, hash)) {
+			victim = entry;
+			break;
+		}
+
+		/* empty entries rank below any stored entry, even one of priority 0 */
+		u64 entry_priority = (check & TTABLE_PRIORITY_MASK) + 1;
+		if (entry_priority < victim_priority) victim = entry, victim_priority = entry_priority;
+	}
+
+	u64 check = ((hash ^ data) & ~TTABLE_PRIORITY_MASK) | priority;
+
+	/* a zero check word marks an empty entry, so force a non-zero priority
+	 * in the (vanishingly rare) case that both coincide
+	 */
+	if (!check) check = 1;
+
+	atomic_store_explicit(&victim->data, data, memory_order_relaxed);
+	atomic_store_explicit(&victim->check, check, memory_order_relaxed);
+}
@@ -1,11 +1,5 @@
 #include "hexes/utils.h"
 
-extern inline void
-swap(void *restrict lhs, void *restrict rhs, size_t size);
-
-extern inline void
-shuffle(void *arr, size_t size, size_t len);
-
 extern inline void
 difftimespec(struct timespec *restrict lhs, struct timespec *restrict rhs, struct timespec *restrict out);
 
@@ -15,6 +9,12 @@ mem_pool_init(struct mem_pool *self, size_t align, size_t capacity);
 extern inline void
 mem_pool_free(struct mem_pool *self);
 
+extern inline bool
+mem_pool_commit(struct mem_pool *self, size_t end);
+
+extern inline bool
+mem_pool_populate(struct mem_pool *self, size_t offset, size_t len);
+
 extern inline void
 mem_pool_reset(struct mem_pool *self);
 
@@ -0,0 +1,30 @@
+#include "hexes/zobrist.h"
+
+#include "hexes/rng.h"
+
+struct zobrist zobrist;
+
+extern inline u64
+zobrist_cell(enum hex_player player, u32 idx);
+
+extern inline u64
+zobrist_turn(enum hex_player player);
+
+void
+zobrist_init(void)
+{
+	static bool initialised = false;
+	if (initialised) return;
+
+	u64 state = ZOBRIST_SEED;
+
+	for (size_t p = 0; p < 2; p++) {
+		for (size_t i = 0; i < ZOBRIST_MAX_CELLS; i++)
+			zobrist.cells[p][i] = rng_splitmix64(&state);
+	}
+
+	zobrist.turn[HEX_PLAYER_BLACK] = rng_splitmix64(&state);
+	zobrist.turn[HEX_PLAYER_WHITE] = rng_splitmix64(&state);
+
+	initialised = true;
+}